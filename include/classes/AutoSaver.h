@@ -0,0 +1,139 @@
+#ifndef AUTOSAVER_H
+#define AUTOSAVER_H
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <classes/WorldFile.h>
+#include <classes/WorldVolume.h>
+
+// saves the whole world without stalling the render loop. slices of the host copy of the world (see WorldMirror.h) are
+// copied out a few per frame, nothing is read back from the GPU, and a worker thread encodes them and writes the world
+// file. slices are copied at different frames, so edits made during a save may be in some slices and not others. the
+// volume's changed flags are cleared when a save starts, so those edits are still flagged for the next incremental
+// save, as are edits the mirror had not handed in yet.
+class AutoSaver
+{
+private:
+    enum SlotState { FREE, ENCODING };
+    static const unsigned int END = UINT_MAX; // queued after the last slice.
+
+    WorldFile& worldFile;
+    WorldVolume& volume;
+    uint64_t totalSize;
+    size_t slotSize;
+    unsigned int slots;
+    std::vector<std::vector<uint32_t>> slices; // a slice of bricks per slot.
+    std::unique_ptr<std::atomic<int>[]> state;
+    std::vector<uint64_t> slotOffset;
+    std::vector<uint64_t> slotLength;
+    unsigned int issueSlot = 0; // slot copied into next, slots are handed to the worker in order.
+    uint64_t nextOffset = 0; // next voxel byte to copy out.
+
+    // worker
+    WorldFile::Encoding encoding;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<unsigned int> queue;
+    std::atomic<bool> finished{false};
+
+    void work() {
+        while (true) {
+            unsigned int slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return !queue.empty(); });
+                slot = queue.front();
+                queue.pop_front();
+            }
+            if (slot == END) break;
+            worldFile.encodeRange(encoding, slotOffset[slot], slotLength[slot], reinterpret_cast<const uint8_t*>(slices[slot].data()));
+            state[slot] = FREE;
+        }
+        succeeded = worldFile.write(encoding);
+        encoding = WorldFile::Encoding(); // frees it until the next save.
+        finished = true;
+    }
+
+    void push(unsigned int slot) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(slot);
+        }
+        cv.notify_one();
+    }
+
+public:
+    bool active = false;
+    bool succeeded = false; // result of the last finished save.
+
+    AutoSaver(WorldFile& file, WorldVolume& vol, uint64_t size, size_t sliceSize, unsigned int slotCount)
+        : worldFile(file), volume(vol) {
+        totalSize = size;
+        slotSize = sliceSize - sliceSize%worldFile.brickBytes;
+        slots = slotCount;
+        slices.resize(slots); // allocated by the first save.
+        state.reset(new std::atomic<int>[slots]);
+        for (unsigned int i = 0; i < slots; i++) state[i] = FREE;
+        slotOffset.assign(slots, 0);
+        slotLength.assign(slots, 0);
+    }
+
+    ~AutoSaver() {
+        while (!update(slots)) std::this_thread::yield();
+    }
+
+    // begins a save. the world file must not be touched by anything else until it finishes.
+    bool start() {
+        if (active) return false;
+        volume.clearChanged(); // everything the mirror handed in up to here ends up in this save.
+
+        nextOffset = 0;
+        finished = false;
+        active = true;
+        worker = std::thread(&AutoSaver::work, this);
+        return true;
+    }
+
+    // advances a running save, copying out at most maxCopies slices. returns true once the save has finished.
+    bool update(unsigned int maxCopies = 1) {
+        if (!active) return true;
+
+        // copy out the next slices and hand them to the worker, as long as it keeps up.
+        for (unsigned int i = 0; i < maxCopies && nextOffset < totalSize && state[issueSlot] == FREE; i++) {
+            uint64_t length = std::min<uint64_t>(slotSize, totalSize-nextOffset);
+            uint64_t brickBytes = worldFile.brickBytes;
+            slices[issueSlot].resize(slotSize/sizeof(uint32_t));
+            volume.copyBricks(nextOffset/brickBytes, length/brickBytes, slices[issueSlot].data());
+            slotOffset[issueSlot] = nextOffset;
+            slotLength[issueSlot] = length;
+            state[issueSlot] = ENCODING;
+            push(issueSlot);
+            nextOffset += length;
+            if (nextOffset == totalSize) push(END);
+            issueSlot = (issueSlot+1) % slots;
+        }
+
+        if (!finished) return false;
+        worker.join();
+        active = false;
+        return true;
+    }
+
+    // runs a whole save, blocking until it is written.
+    bool run() {
+        while (!update(slots)) std::this_thread::yield(); // finish a running save first.
+        start();
+        while (!update(slots)) std::this_thread::yield();
+        return succeeded;
+    }
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef BRICKATLAS_H
+#define BRICKATLAS_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <iostream>
+
+// the brick pool again as an R8UI 3D texture, so the high res pass can fetch voxels through the texture cache instead of
+// unpacking bytes out of ssbo0. every pool slot is a 4^3 tile, 256x256 tiles to a layer, slot s at tile
+// (s%256, s/256%256, s/65536). bound as texture unit 1 for fetching and image unit 2 for filling.
+// the pool stays what everything writes to, the material mip pass copies the bricks it rebuilds into their tiles
+// (see MaterialMips.h), so the atlas is current by the time the frame is drawn. only built with VOXEL_ATLAS.
+class BrickAtlas
+{
+public:
+    static const uint32_t TILES = 256; // tiles along x and y, ATLAS_TILES in the shaders.
+
+    GLuint texture = 0;
+    uint32_t layers;
+
+    BrickAtlas(uint32_t poolSlots) {
+        layers = (poolSlots + TILES*TILES - 1)/(TILES*TILES);
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+        if (GLint(layers*4) > maxSize) std::cout<<"Brick atlas needs "<<layers*4<<" layers, the GPU allows "<<maxSize<<". Lower POOL_BRICKS"<<std::endl;
+
+        glGenTextures(1, &texture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexStorage3D(GL_TEXTURE_3D, 1, GL_R8UI, TILES*4, TILES*4, layers*4);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindImageTexture(2, texture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R8UI);
+        glActiveTexture(GL_TEXTURE0);
+        std::cout<<"Brick atlas: "<<uint64_t(TILES)*TILES*layers*64/(1024*1024)<<" MiB"<<std::endl;
+    }
+
+    ~BrickAtlas() {
+        glDeleteTextures(1, &texture);
+    }
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef BRICKPOOL_H
+#define BRICKPOOL_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+#include <classes/GLshader.h>
+
+// sparse voxel storage. only bricks holding something take memory:
+//   binding 0 : pool, slots of one brick (BRICK_UINTS uints) each. slot 0 is the shared air brick and always stays zero.
+//   binding 6 : brick map, the pool slot of every brick (indexed by cm, as the occupancy mask), 0 for air. bricks of a
+//               single material (solid stone, deep water) take no slot, their entry is the material tagged
+//               with the top bit (UNIFORM in the shaders) instead.
+//   binding 7 : allocator, the header below then the free slot stack, the emptied brick list and the orphaned slot list.
+//   binding 10: solid bits, two uints per slot with a bit per voxel (morton order within the brick), kept in sync with
+//               the pool by everything that writes voxels, so marchers only read the pool when they hit something.
+//   binding 18: compact pool, the CompactHeader below then its free slot stack, the released slot list and records of
+//               COMPACT_UINTS uints: 64 two bit indices into a palette of four materials, the palette, and the indices
+//               of the 2^3 mip cells. bricks of two to four materials (most of the terrain surface) take 24 bytes there
+//               instead of 64 in the pool, their entry is the compact slot tagged with the second bit (COMPACT).
+// shaders allocate slots as they write into air bricks (allocBrick() in each shader). slots are only freed by the
+// recycle pass between dispatches, so nothing can write into a slot while it is being freed, and free slots stay zero.
+// slots lost to two threads allocating the same brick at once are orphaned, and recycled the same way.
+// compact bricks are made by the terrain shader and scatter() as bricks come in, and from pool bricks by the compact pass
+// (compact()), which sweeps a window of the brick map each frame. they are never written in place, writers copy them
+// back into a pool slot first (allocBrick() again) and release the compact slot, which the recycle pass frees.
+// the brick map, compact pool and the helpers decoding them are in shaders/4.3.bricks.glsl, included by the shaders.
+class BrickPool
+{
+public:
+    struct Header {
+        uint32_t freeCount; // slots on the free stack.
+        uint32_t nextSlot; // first slot never handed out.
+        uint32_t emptiedCount; // bricks that may have emptied since the last recycle.
+        uint32_t orphanCount;
+        uint32_t poolSlots;
+        uint32_t listSize; // capacity of the emptied and orphaned lists, overflowing bricks stay allocated.
+        uint32_t allocFailures; // writes dropped because the pool was full.
+        uint32_t listOverflows; // emptied bricks and orphaned slots past listSize, their slots stay taken until a reset.
+    };
+
+    struct CompactHeader {
+        uint32_t freeCount;
+        uint32_t nextSlot;
+        uint32_t slots;
+        uint32_t releasedCount; // slots released since the last recycle.
+        uint32_t failures; // bricks left in the pool because the compact pool was full.
+    };
+
+    static const uint32_t COMPACT_UINTS = 6;
+
+    GLuint pool = 0;
+    GLuint map = 0;
+    GLuint alloc = 0;
+    GLuint stage = 0; // brick records for scatter(), binding 8.
+    GLuint bits = 0;
+    GLuint compactPool = 0;
+    uint32_t slots;
+    uint32_t compactSlots;
+    uint32_t listSize;
+    uint32_t brickUints;
+    size_t stageSize;
+    uint64_t mapSize;
+    uint64_t compactCursor = 0; // next brick the compact pass looks at.
+
+    BrickPool(uint64_t numBricks, uint32_t poolSlots, uint32_t compactBricks, uint32_t lists, uint32_t brickSize, size_t stageBytes, Shader& scatter, Shader& dense, Shader& recycle, Shader& clear, Shader& compact)
+        : scatterShader(scatter), denseShader(dense), recycleShader(recycle), clearShader(clear), compactShader(compact) {
+        slots = poolSlots;
+        compactSlots = compactBricks;
+        mapSize = numBricks;
+        listSize = lists;
+        brickUints = brickSize;
+        stageSize = stageBytes;
+
+        GLuint buffers[6];
+        glGenBuffers(6, buffers);
+        pool = buffers[0];
+        map = buffers[1];
+        alloc = buffers[2];
+        stage = buffers[3];
+        bits = buffers[4];
+        compactPool = buffers[5];
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, pool);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint)*brickUints*uint64_t(slots), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, pool);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, map);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint)*numBricks, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, map);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, alloc);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Header) + sizeof(GLuint)*(uint64_t(slots) + 2*uint64_t(listSize)), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, alloc);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, stage);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, stageSize, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, stage);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, bits);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 2*sizeof(GLuint)*uint64_t(slots), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, bits);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, compactPool);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(CompactHeader) + sizeof(GLuint)*(2+COMPACT_UINTS)*uint64_t(compactSlots), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 18, compactPool);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        reset();
+    }
+
+    ~BrickPool() {
+        GLuint buffers[6] = {pool, map, alloc, stage, bits, compactPool};
+        glDeleteBuffers(6, buffers);
+    }
+
+    // makes the whole world air, with every slot free.
+    void reset() {
+        Header header = {0, 1, 0, 0, slots, listSize, 0, 0}; // slot 0 is the air brick.
+        CompactHeader compactHeader = {0, 0, compactSlots, 0, 0};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, pool);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, map);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, bits);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, alloc);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Header), &header);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, compactPool);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(CompactHeader), &compactHeader);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // frees the slots of bricks that emptied, and orphaned slots. call between the passes that edit voxels.
+    void recycle() {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        recycleShader.use();
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // moves the next count bricks of up to four materials out of the pool, wrapping around the world. call between the
+    // passes that edit voxels, after recycle() so the compact slots released meanwhile are free again.
+    void compact(uint64_t count) {
+        if (compactSlots == 0) return;
+        count = std::min(count, mapSize);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        compactShader.use();
+        while (count > 0) {
+            uint64_t run = std::min({count, mapSize - compactCursor, uint64_t(65535)*64}); // work group limit.
+            compactShader.setInt("firstBrick", int(compactCursor));
+            compactShader.setInt("bricks", int(run));
+            glDispatchCompute(GLuint((run+63)/64), 1, 1);
+            compactCursor = (compactCursor + run) % mapSize;
+            count -= run;
+        }
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // writes count {brick index, brick uints} records, already copied into stage, into their bricks.
+    void scatter(uint32_t count) {
+        if (count == 0) return;
+        scatterShader.use();
+        scatterShader.setInt("records", count);
+        glDispatchCompute((count+63)/64, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // makes bricks [firstBrick, firstBrick+count) air, freeing their slots, and marks them empty in the occupancy mask.
+    // both have to be whole mask words (multiples of 32).
+    void clear(uint64_t firstBrick, uint64_t count) {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        clearShader.use();
+        clearShader.setInt("firstBrick", int(firstBrick));
+        clearShader.setInt("bricks", int(count));
+        glDispatchCompute(GLuint((count/32+63)/64), 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // writes bricks [firstBrick, firstBrick+count) densely (air included) into dst at dstOffset, for readback.
+    // dstOffset has to meet GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT.
+    void densify(uint64_t firstBrick, uint64_t count, GLuint dst, GLintptr dstOffset) {
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 9, dst, dstOffset, count*brickUints*sizeof(GLuint));
+        denseShader.use();
+        denseShader.setInt("firstBrick", int(firstBrick));
+        denseShader.setInt("bricks", int(count));
+        glDispatchCompute(GLuint((count+63)/64), 1, 1);
+    }
+
+    // reads the allocator header back, stalls until the GPU catches up, so only for the odd status report.
+    Header status(CompactHeader* compactHeader = nullptr) {
+        Header header = {};
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, alloc);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Header), &header);
+        if (compactHeader) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, compactPool);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(CompactHeader), compactHeader);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return header;
+    }
+
+    // GPU memory of the buffers above, the stage buffer left out.
+    uint64_t footprint() const {
+        uint64_t uints = uint64_t(slots)*(brickUints + 2 + 1) + mapSize + 2*uint64_t(listSize) + (2+COMPACT_UINTS)*uint64_t(compactSlots);
+        return sizeof(GLuint)*uints + sizeof(Header) + sizeof(CompactHeader);
+    }
+
+    void report() {
+        CompactHeader compactHeader = {};
+        Header header = status(&compactHeader);
+        std::cout<<"Brick storage: "<<footprint()/(1024*1024)<<" MiB on the GPU"<<std::endl;
+        uint32_t used = std::min(header.nextSlot, slots) - 1 - header.freeCount;
+        std::cout<<"Brick pool: "<<used<<" of "<<slots-1<<" bricks ("<<uint64_t(used)*brickUints*sizeof(GLuint)/(1024*1024)<<" MiB)"<<std::endl;
+        if (compactSlots != 0) {
+            uint32_t compactUsed = std::min(compactHeader.nextSlot, compactSlots) - compactHeader.freeCount;
+            std::cout<<"Compact bricks: "<<compactUsed<<" of "<<compactSlots<<" ("<<uint64_t(compactUsed)*COMPACT_UINTS*sizeof(GLuint)/(1024*1024)<<" MiB)"<<std::endl;
+            if (compactHeader.failures != 0) std::cout<<"Compact pool full, "<<compactHeader.failures<<" bricks stayed in the brick pool. Raise COMPACT_BRICKS"<<std::endl;
+        }
+        if (header.allocFailures != 0) std::cout<<"Brick pool full, "<<header.allocFailures<<" writes were dropped. Raise POOL_BRICKS"<<std::endl;
+        if (header.listOverflows != 0) std::cout<<"Brick lists overflowed, "<<header.listOverflows<<" slots were not recycled. Raise BRICK_LISTS"<<std::endl;
+    }
+
+private:
+    Shader& scatterShader;
+    Shader& denseShader;
+    Shader& recycleShader;
+    Shader& clearShader;
+    Shader& compactShader;
+};
+
+#endif
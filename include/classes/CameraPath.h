@@ -0,0 +1,166 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <classes/PlayerController.h>
+
+// a camera flight for benchmarks, so passes and settings can be compared over the same views. F9 records the player
+// into a text file of keyframes, a "time x y z dirX dirY dirZ" line each, F10 flies it back. playback moves a fixed
+// step along the path per frame rather than the frame time, so every run renders the same frames whatever the frame
+// rate. the file can also be written by hand.
+class CameraPath
+{
+public:
+    struct Key {
+        float time;
+        float pos[3];
+        float dir[3];
+    };
+
+    bool recording = false;
+    bool playing = false;
+    bool started = false; // playback began this frame.
+    bool finished = false; // playback ended this frame, the averages are in.
+    unsigned int frames = 0; // frames played so far.
+    double frameTime = 0.0; // seconds spent on them.
+
+    CameraPath(const std::string& path, float keyInterval, float playStep) : file(path), interval(keyInterval), step(playStep) {}
+
+    // call once a frame, after the player handled its inputs, which the path overrides while playing.
+    void update(GLFWwindow* window, PlayerController& player, float time, float deltaTime) {
+        started = false;
+        finished = false;
+        bool recordPress = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+        bool playPress = glfwGetKey(window, GLFW_KEY_F10) == GLFW_PRESS;
+        if (recordPress && !lastRecordPress && !playing) {
+            if (recording) stopRecording();
+            else {
+                keys.clear();
+                recordStart = time;
+                lastKey = -interval;
+                recording = true;
+                std::cout<<"Recording camera path"<<std::endl;
+            }
+        }
+        if (playPress && !lastPlayPress && !recording) {
+            if (playing) stopPlaying();
+            else if (load()) {
+                playing = true;
+                started = true;
+                frames = 0;
+                frameTime = 0.0;
+                std::cout<<"Playing camera path "<<file<<", "<<keys.back().time<<"s"<<std::endl;
+            }
+        }
+        lastRecordPress = recordPress;
+        lastPlayPress = playPress;
+
+        if (recording && time - recordStart - lastKey >= interval) {
+            lastKey = time - recordStart;
+            keys.push_back({lastKey, {player.posX, player.posY, player.posZ}, {player.dirX, player.dirY, player.dirZ}});
+        }
+
+        if (playing) {
+            if (!started) {
+                frames++;
+                frameTime += deltaTime;
+            }
+            float t = float(frames)*step;
+            if (t > keys.back().time) {
+                stopPlaying();
+                finished = true;
+                return;
+            }
+            pose(t, player);
+        }
+    }
+
+    // appends a line for the flight that just finished to a csv log, so runs of different settings, which take a restart
+    // apart, end up side by side. mode names the settings, passMs is the pass time the flight measured.
+    void logResult(const std::string& logFile, const std::string& mode, double passMs) {
+        if (frames == 0) return;
+        bool fresh = !std::ifstream(logFile).good();
+        std::ofstream out(logFile, std::ios::app);
+        if (fresh) out<<"path,mode,frames,frame ms,pass ms\n";
+        out<<file<<","<<mode<<","<<frames<<","<<frameTime*1000.0/frames<<","<<passMs<<"\n";
+        if (!out) std::cout<<"Could not write benchmark log "<<logFile<<std::endl;
+    }
+
+private:
+    std::string file;
+    float interval; // seconds between recorded keys.
+    float step; // seconds of path per played frame.
+    std::vector<Key> keys;
+    float recordStart = 0.0f;
+    float lastKey = 0.0f;
+    bool lastRecordPress = false;
+    bool lastPlayPress = false;
+
+    void stopRecording() {
+        recording = false;
+        std::ofstream out(file, std::ios::trunc);
+        out<<"# time x y z dirX dirY dirZ\n";
+        for (const Key& k : keys) {
+            out<<k.time<<" "<<k.pos[0]<<" "<<k.pos[1]<<" "<<k.pos[2]<<" "<<k.dir[0]<<" "<<k.dir[1]<<" "<<k.dir[2]<<"\n";
+        }
+        if (out) std::cout<<"Camera path saved to "<<file<<", "<<keys.size()<<" keys"<<std::endl;
+        else std::cout<<"Could not write camera path "<<file<<std::endl;
+    }
+
+    void stopPlaying() {
+        playing = false;
+        if (frames != 0) std::cout<<"Camera path done, "<<frames<<" frames, "<<frameTime*1000.0/frames<<" ms a frame"<<std::endl;
+    }
+
+    bool load() {
+        std::ifstream in(file);
+        keys.clear();
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            Key k;
+            std::istringstream fields(line);
+            if (fields>>k.time>>k.pos[0]>>k.pos[1]>>k.pos[2]>>k.dir[0]>>k.dir[1]>>k.dir[2]) keys.push_back(k);
+        }
+        if (keys.size() < 2) {
+            std::cout<<"No camera path in "<<file<<", record one with F9"<<std::endl;
+            return false;
+        }
+        std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) { return a.time < b.time; });
+        return true;
+    }
+
+    // position and direction at time t along the path, straight between keys.
+    void pose(float t, PlayerController& player) {
+        size_t i = 1;
+        while (i < keys.size()-1 && keys[i].time < t) i++;
+        const Key& a = keys[i-1];
+        const Key& b = keys[i];
+        float f = b.time > a.time ? std::clamp((t - a.time)/(b.time - a.time), 0.0f, 1.0f) : 1.0f;
+        float dir[3];
+        for (int c = 0; c < 3; c++) dir[c] = a.dir[c] + (b.dir[c] - a.dir[c])*f;
+        float len = std::sqrt(dir[0]*dir[0] + dir[1]*dir[1] + dir[2]*dir[2]);
+        if (len < 1e-6f) {
+            len = 1.0f;
+            for (int c = 0; c < 3; c++) dir[c] = b.dir[c];
+        }
+        player.posX = a.pos[0] + (b.pos[0] - a.pos[0])*f;
+        player.posY = a.pos[1] + (b.pos[1] - a.pos[1])*f;
+        player.posZ = a.pos[2] + (b.pos[2] - a.pos[2])*f;
+        player.dirX = dir[0]/len;
+        player.dirY = dir[1]/len;
+        player.dirZ = dir[2]/len;
+    }
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+#include <classes/GLshader.h>
+
+// chebyshev distance from every brick to the nearest solid brick, capped at 16 bricks, a byte per brick at binding 11
+// after a small header. a brick at distance d has only empty bricks within d-1 of it, so marchers can leave that
+// whole cube in one step.
+// passes that flip a bricks occupancy grow a dirty box in the header (distDirty() in each shader), and update() rebuilds
+// the field within 15 bricks of it. the box never comes back to the host, the rebuild passes are dispatched indirectly.
+// distances wrap around x and z like the paged world does.
+class DistanceField
+{
+public:
+    struct Header {
+        GLuint dispatch[9]; // x, y, z work groups of the three rebuild passes.
+        GLint dirtyLo[3];
+        GLint dirtyHi[3]; // inclusive, below dirtyLo when nothing flipped.
+        GLint rebuildLo[3];
+        GLint rebuildHi[3];
+    };
+
+    GLuint field = 0;
+    GLuint scratch = 0; // results of the x and y passes, binding 12.
+    unsigned int axisBricks[3]; // along x, y and z.
+
+    DistanceField(uint64_t numBricks, unsigned int bricksX, unsigned int bricksY, unsigned int bricksZ, Shader& prepare, Shader& pass)
+        : prepareShader(prepare), passShader(pass) {
+        axisBricks[0] = bricksX;
+        axisBricks[1] = bricksY;
+        axisBricks[2] = bricksZ;
+
+        glGenBuffers(1, &field);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, field);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Header) + numBricks, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, field);
+        glGenBuffers(1, &scratch);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scratch);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 2*numBricks, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, scratch);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        markAll();
+    }
+
+    ~DistanceField() {
+        glDeleteBuffers(1, &field);
+        glDeleteBuffers(1, &scratch);
+    }
+
+    // has the next update() rebuild the whole field.
+    void markAll() {
+        Header header = {{0, 0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 0}, {GLint(axisBricks[0])-1, GLint(axisBricks[1])-1, GLint(axisBricks[2])-1}, {0, 0, 0}, {0, 0, 0}};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, field);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Header), &header);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // rebuilds the field around the bricks flipped since the last update, call after the occupancy mask is current.
+    void update() {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        prepareShader.use();
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, field);
+        passShader.use();
+        for (int axis = 0; axis < 3; axis++) {
+            passShader.setInt("axis", axis);
+            glDispatchComputeIndirect(axis*3*sizeof(GLuint));
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    }
+
+private:
+    Shader& prepareShader;
+    Shader& passShader;
+};
+
+#endif
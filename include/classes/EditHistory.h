@@ -0,0 +1,163 @@
+#ifndef EDITHISTORY_H
+#define EDITHISTORY_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+
+#include <classes/GLshader.h>
+#include <classes/StagingRing.h>
+
+// undo/redo of block edits. before editing, the block editor copies every brick its brush touches into a snapshot
+// pool on the GPU (ssbo5), a ring of {brick index, brick uints} records. each edit owns a run of records, the oldest
+// edits are dropped when the pool runs out. undoing swaps the records with the bricks in the world, so the same
+// records then hold what redo swaps back in.
+// an edit snapshots either every brick of its brush or none (nothing hit), so it reserves the whole brush up front and
+// the count the editor wrote is read back through a small readback ring instead of stalling on it. edits that hit
+// nothing turn out blank a few frames later, and are dropped or skipped. so do edits the brick pool could not take,
+// which the editor rejects whole, they are flagged in rejected for the host to free slots and try again.
+class EditHistory
+{
+private:
+    struct Edit {
+        uint32_t start; // first record in the pool.
+        uint32_t count;
+        int slot; // readback slot holding the snapshot count and rejected flag, -1 once it landed.
+        bool blank; // hit nothing, its records hold nothing to swap.
+    };
+
+    GLuint poolBuffer;
+    StagingRing counts; // snapshot counts and rejected flags on their way back, a slot per edit.
+    uint32_t capacity; // records in the pool.
+    uint32_t brickSide; // voxels along a brick edge.
+    std::deque<Edit> edits; // oldest first.
+    size_t undone = 0; // edits at the back that were undone, and can be redone.
+    uint32_t head = 0; // record the next edit starts at.
+    uint64_t used = 0; // records held by edits that can still be undone or redone.
+    uint32_t reserved = 0; // records the edit being made can take, 0 when it is not snapshotted.
+    bool editing = false; // between begin() and commit().
+    unsigned int pending = 0; // edits whose count has not landed.
+
+    // takes in the counts that have landed, in order. blocking waits for all of them.
+    void land(bool block) {
+        if (pending == 0) return;
+        if (block) counts.finish();
+        for (size_t i = 0; i < edits.size(); i++) {
+            Edit& edit = edits[i];
+            if (edit.slot < 0) continue;
+            if (!counts.ready(edit.slot)) return; // slots land in order.
+            const GLuint* landed = reinterpret_cast<const GLuint*>(counts.data(edit.slot));
+            GLuint count = landed[0];
+            if (landed[1] != 0) rejected = true;
+            edit.slot = -1;
+            pending--;
+            if (count != 0) continue;
+            edit.blank = true;
+            if (i == edits.size()-1) { // the newest, its records go back to the pool.
+                used -= edit.count;
+                head = edit.start;
+                edits.pop_back();
+            }
+        }
+    }
+
+    // undoing and redoing are the same swap.
+    void swap(Shader& undoShader, const Edit& edit) {
+        undoShader.use();
+        undoShader.setInt("snapshotBase", edit.start);
+        undoShader.setInt("snapshotBricks", edit.count);
+        undoShader.setInt("snapshotCapacity", capacity);
+        glDispatchCompute((edit.count+63)/64, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+public:
+    static const unsigned int READ_SLOTS = 4; // edits whose count can be in flight.
+
+    bool rejected = false; // an edit the brick pool could not take landed, the caller clears it.
+
+    EditHistory(GLuint pool, uint64_t poolRecords, unsigned int passRes) : counts(READ_SLOTS*2*sizeof(GLuint), READ_SLOTS, true) {
+        poolBuffer = pool;
+        capacity = uint32_t(poolRecords);
+        brickSide = passRes;
+    }
+
+    // sets up the block editor to snapshot the bricks a brush of brushSize touches, call before dispatching it.
+    // makes room for the snapshots first, dropping the oldest edits and anything that was undone.
+    void begin(Shader& editShader, int brushSize) {
+        land(pending == READ_SLOTS); // the ring slot the edit reads into has to be free.
+        while (undone > 0) {
+            used -= edits.back().count;
+            edits.pop_back();
+            undone--;
+        }
+        head = edits.empty() ? head : (edits.back().start + edits.back().count) % capacity;
+
+        uint64_t side = brushSize > int(brickSide) ? brushSize/brickSide : 1;
+        uint64_t worst = side*side*side;
+        bool fits = worst <= capacity;
+        if (fits && used + worst > capacity) land(true); // edits are only dropped once their counts are in.
+        while (fits && used + worst > capacity) {
+            used -= edits.front().count;
+            edits.pop_front();
+        }
+
+        reserved = fits ? uint32_t(worst) : 0;
+        editing = true;
+        editShader.setInt("snapshotBase", head);
+        editShader.setInt("snapshotCapacity", fits ? capacity : 0); // 0 skips snapshotting, the edit cannot be undone.
+        if (!fits) std::cout<<"Edit too large for the undo budget, it cannot be undone"<<std::endl;
+    }
+
+    // records the edit the block editor just made, with its whole brush reserved until the count comes back. edits that
+    // are not snapshotted reserve nothing and land blank, they are only read back for the rejected flag.
+    void commit() {
+        if (!editing) return;
+        editing = false;
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        int slot = int(counts.download(poolBuffer, 0, 2*sizeof(GLuint)));
+        edits.push_back({head, reserved, slot, false});
+        pending++;
+        used += reserved;
+        head = (head + reserved) % capacity;
+        reserved = 0;
+    }
+
+    // takes in the counts that landed since, call once a frame. never blocks.
+    void update() {
+        land(false);
+    }
+
+    // forgets every edit, for when the bricks the snapshots belong to now hold another part of the world.
+    void clear() {
+        land(true); // nothing may land into edits that are gone.
+        rejected = false; // nor be retried in the world that replaced them.
+        edits.clear();
+        undone = 0;
+        used = 0;
+    }
+
+    // blank edits are passed over, they changed nothing. the counts are usually in long before a key is pressed.
+    bool undo(Shader& undoShader) {
+        land(true);
+        size_t i = undone;
+        while (i < edits.size() && edits[edits.size()-1-i].blank) i++;
+        if (i == edits.size()) return false;
+        undone = i+1;
+        swap(undoShader, edits[edits.size()-undone]);
+        return true;
+    }
+
+    bool redo(Shader& undoShader) {
+        land(true);
+        while (undone > 0 && edits[edits.size()-undone].blank) undone--;
+        if (undone == 0) return false;
+        swap(undoShader, edits[edits.size()-undone]);
+        undone--;
+        return true;
+    }
+};
+
+#endif
@@ -14,6 +14,10 @@ class Shader
 public:
     unsigned int ID;
 
+    // #defines added after the #version line of every shader compiled from here on, so shaders are specialized on
+    // settings only the host knows (the world size).
+    static inline std::string defines;
+
     // Constructor: vertex + fragment
     Shader(const char* vertexPath, const char* fragmentPath)
     {
@@ -71,13 +75,46 @@ private:
         return stream.str();
     }
 
+    // pastes files named by #include "file" lines in, looked up next to the shader, so shaders share declarations
+    // instead of keeping copies that drift apart. GLSL has no includes of its own.
+    std::string resolveIncludes(const std::string& code, const std::string& path)
+    {
+        if (code.find("#include \"") == std::string::npos) return code;
+        std::string dir = path.substr(0, path.find_last_of('/') + 1);
+        std::istringstream lines(code);
+        std::string out, line;
+        int number = 0;
+        while (std::getline(lines, line))
+        {
+            number++;
+            if (line.compare(0, 10, "#include \"") != 0)
+            {
+                out += line + "\n";
+                continue;
+            }
+            std::string name = line.substr(10, line.find('"', 10) - 10);
+            // #line keeps compile errors pointing at the lines of each file, source string 1 is the included one.
+            out += "#line 1 1\n" + loadSourceFromFile((dir + name).c_str()) + "\n#line " + std::to_string(number + 1) + " 0\n";
+        }
+        return out;
+    }
+
+    std::string injectDefines(const std::string& code)
+    {
+        if (defines.empty() || code.compare(0, 8, "#version") != 0) return code;
+        size_t line = code.find('\n') + 1;
+        if (line == 0) return code;
+        // #line keeps compile errors pointing at the lines of the file.
+        return code.substr(0, line) + defines + "#line 2\n" + code.substr(line);
+    }
+
     void compileAndLink(const std::vector<std::pair<GLenum, const char*>>& shaders)
     {
         std::vector<unsigned int> shaderIDs;
 
         for (auto& [type, path] : shaders)
         {
-            std::string code = loadSourceFromFile(path);
+            std::string code = injectDefines(resolveIncludes(loadSourceFromFile(path), path));
             const char* codeCStr = code.c_str();
 
             unsigned int shader = glCreateShader(type);
@@ -0,0 +1,80 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <string>
+
+// times a stretch of GPU work with timer queries, for comparing passes on the same camera flight. queries are read a
+// few frames late so nothing waits on them, and the average is printed every interval seconds.
+class GpuTimer
+{
+private:
+    static const int QUERIES = 4;
+    GLuint queries[QUERIES];
+    bool issued[QUERIES] = {};
+    int next = 0;
+    std::string name;
+    double total = 0.0; // milliseconds since the last report.
+    unsigned int samples = 0;
+    float lastReport = 0.0f;
+    double runTotal = 0.0; // milliseconds since startRun(), for a whole camera path.
+    unsigned int runSamples = 0;
+
+public:
+    float interval;
+
+    GpuTimer(const std::string& label, float reportInterval) : name(label), interval(reportInterval) {
+        glGenQueries(QUERIES, queries);
+    }
+
+    ~GpuTimer() {
+        glDeleteQueries(QUERIES, queries);
+    }
+
+    void begin() {
+        // the oldest query comes back first, skipped when it has not yet.
+        if (issued[next]) {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[next], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(queries[next], GL_QUERY_RESULT, &elapsed);
+                total += double(elapsed)/1e6;
+                samples++;
+                runTotal += double(elapsed)/1e6;
+                runSamples++;
+            }
+        }
+        glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    }
+
+    void startRun() {
+        runTotal = 0.0;
+        runSamples = 0;
+    }
+
+    // average since startRun(), regardless of the interval.
+    double runAverage() const {
+        return runSamples == 0 ? 0.0 : runTotal/runSamples;
+    }
+
+    void reportRun() {
+        if (runSamples == 0) return;
+        std::cout<<name<<": "<<runAverage()<<" ms over "<<runSamples<<" frames"<<std::endl;
+    }
+
+    void end(float time) {
+        glEndQuery(GL_TIME_ELAPSED);
+        issued[next] = true;
+        next = (next+1) % QUERIES;
+        if (interval <= 0.0f || time - lastReport < interval || samples == 0) return;
+        std::cout<<name<<": "<<total/samples<<" ms"<<std::endl;
+        total = 0.0;
+        samples = 0;
+        lastReport = time;
+    }
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef MATERIALMIPS_H
+#define MATERIALMIPS_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+#include <classes/GLshader.h>
+
+// coarser copies of the world for tracing far away, where a pixel covers several voxels. a cell is air unless at least
+// half of the cells below it are solid, then it takes the most common material among them.
+//   binding 14: a dirty bit per brick, then a byte per brick (4^3 voxels), then a byte per 8 bricks (8^3 voxels).
+//   binding 15: a byte per 2^3 cell, two uints per pool slot like the solid bits. uniform and air bricks need none.
+// passes that write voxels set the dirty bit of the brick (mipDirty in each shader), update() rebuilds those bricks and
+// the 8^3 cells above them.
+class MaterialMips
+{
+public:
+    GLuint levels = 0;
+    GLuint cells = 0;
+    uint64_t dirtyWords;
+
+    MaterialMips(uint64_t numBricks, uint32_t poolSlots, Shader& mips) : mipShader(mips) {
+        dirtyWords = numBricks/32;
+
+        glGenBuffers(1, &levels);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, levels);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint)*dirtyWords + numBricks + numBricks/8, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, levels);
+        glGenBuffers(1, &cells);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, cells);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 2*sizeof(GLuint)*uint64_t(poolSlots), nullptr, GL_DYNAMIC_DRAW);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, cells);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        markAll();
+    }
+
+    ~MaterialMips() {
+        glDeleteBuffers(1, &levels);
+        glDeleteBuffers(1, &cells);
+    }
+
+    // has the next update() rebuild every brick.
+    void markAll() {
+        GLuint ones = 0xFFFFFFFFu;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, levels);
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, sizeof(GLuint)*dirtyWords, GL_RED_INTEGER, GL_UNSIGNED_INT, &ones);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // rebuilds the bricks written since the last update.
+    void update() {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        mipShader.use();
+        glDispatchCompute(GLuint((dirtyWords+63)/64), 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT); // the brick atlas is filled here too.
+    }
+
+private:
+    Shader& mipShader;
+};
+
+#endif
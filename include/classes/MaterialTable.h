@@ -0,0 +1,69 @@
+#ifndef MATERIALTABLE_H
+#define MATERIALTABLE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// properties of every material, one entry per voxel value at binding 13, so passes read them instead of keeping their
+// own copies. an entry is two uints, fetched as one uvec2 by the shaders:
+//   x: color and opacity, rgba8 (unpackUnorm4x8() in the shaders).
+//   y: flags, the physics class in the low two bits (MAT_PHYSICS), then MAT_EMISSIVE for materials that are not
+//      shaded by the sun.
+// entry 0 is air, its color is the sky. there is room for all 255 materials a voxel byte holds.
+class MaterialTable
+{
+public:
+    enum Physics : uint32_t {
+        STATIC = 0,
+        POWDER = 1,
+        LIQUID = 2
+    };
+
+    static const uint32_t EMISSIVE = 4;
+    static const uint32_t SIZE = 256;
+
+    struct Material {
+        float color[3];
+        float opacity;
+        uint32_t physics;
+        bool emissive;
+    };
+
+    GLuint buffer = 0;
+
+    MaterialTable(const std::vector<Material>& materials) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 2*sizeof(GLuint)*SIZE, nullptr, GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        upload(materials);
+    }
+
+    ~MaterialTable() {
+        glDeleteBuffers(1, &buffer);
+    }
+
+    // replaces the table, materials past the end of the list are left black, opaque and static.
+    void upload(const std::vector<Material>& materials) {
+        std::vector<GLuint> entries(2*SIZE, 0xFF000000u);
+        for (size_t i = 0; i < std::min<size_t>(materials.size(), SIZE); i++) {
+            const Material& mat = materials[i];
+            entries[2*i] = unorm8(mat.color[0]) | unorm8(mat.color[1]) << 8 | unorm8(mat.color[2]) << 16 | unorm8(mat.opacity) << 24;
+            entries[2*i+1] = (mat.physics & 3u) | (mat.emissive ? EMISSIVE : 0u);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, entries.size()*sizeof(GLuint), entries.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+private:
+    static uint32_t unorm8(float v) {
+        return uint32_t(std::clamp(v, 0.0f, 1.0f)*255.0f + 0.5f);
+    }
+};
+
+#endif
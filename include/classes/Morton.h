@@ -0,0 +1,97 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <algorithm>
+#include <cstdint>
+
+// host side of the morton encoding/decoding used by the shaders (10 bits per axis).
+inline uint32_t part1by1(uint32_t x) {
+    x &= 0x0000FFFFu;
+    x = (x | (x << 8)) & 0x00FF00FFu;
+    x = (x | (x << 4)) & 0x0F0F0F0Fu;
+    x = (x | (x << 2)) & 0x33333333u;
+    x = (x | (x << 1)) & 0x55555555u;
+    return x;
+}
+
+inline uint32_t compact1by1(uint32_t x) {
+    x &= 0x55555555u;
+    x = (x | (x >> 1)) & 0x33333333u;
+    x = (x | (x >> 2)) & 0x0F0F0F0Fu;
+    x = (x | (x >> 4)) & 0x00FF00FFu;
+    x = (x | (x >> 8)) & 0x0000FFFFu;
+    return x;
+}
+
+inline uint32_t part1by2(uint32_t x) {
+    x &= 0x000003FFu;
+    x = (x | (x << 16)) & 0x030000FFu;
+    x = (x | (x << 8))  & 0x0300F00Fu;
+    x = (x | (x << 4))  & 0x030C30C3u;
+    x = (x | (x << 2))  & 0x09249249u;
+    return x;
+}
+
+inline uint32_t compact1by2(uint32_t x) {
+    x &= 0x09249249u;
+    x = (x | (x >> 2))  & 0x030C30C3u;
+    x = (x | (x >> 4))  & 0x0300F00Fu;
+    x = (x | (x >> 8))  & 0x030000FFu;
+    x = (x | (x >> 16)) & 0x000003FFu;
+    return x;
+}
+
+inline uint32_t morton3D(uint32_t x, uint32_t y, uint32_t z) {
+    return part1by2(x) | (part1by2(y) << 1) | (part1by2(z) << 2);
+}
+
+inline void mortonDecode(uint32_t m, uint32_t& x, uint32_t& y, uint32_t& z) {
+    x = compact1by2(m);
+    y = compact1by2(m >> 1);
+    z = compact1by2(m >> 2);
+}
+
+// world layout, as worldIndex()/worldCoord() in the shaders. sizes are powers of two with y the smallest. the world is a
+// row of sizeY^3 cubes, morton ordered inside, and the cubes are morton ordered along x and z with the longer axis on
+// top, so a cube world is plain morton order and any sizeY^3 (or smaller aligned) cube is one contiguous range.
+struct WorldLayout {
+    uint32_t size[3];
+
+    WorldLayout(uint32_t x, uint32_t y, uint32_t z) : size{x, y, z} {}
+
+    // the same world in cells of scale voxels.
+    WorldLayout scaled(uint32_t scale) const {
+        return WorldLayout(size[0]/scale, size[1]/scale, size[2]/scale);
+    }
+
+    uint64_t cells() const {
+        return uint64_t(size[0])*size[1]*size[2];
+    }
+
+    // wraps around the world.
+    uint32_t index(uint32_t x, uint32_t y, uint32_t z) const {
+        x &= size[0]-1;
+        y &= size[1]-1;
+        z &= size[2]-1;
+        uint32_t side = size[1];
+        uint32_t shared = std::min(size[0], size[2])/side; // cubes along the shorter of x and z.
+        uint32_t cx = x/side, cz = z/side;
+        uint32_t cube = part1by1(cx%shared) | (part1by1(cz%shared) << 1) | (cx|cz)/shared*shared*shared;
+        return cube*side*side*side + morton3D(x & (side-1), y, z & (side-1));
+    }
+
+    void decode(uint32_t i, uint32_t& x, uint32_t& y, uint32_t& z) const {
+        uint32_t side = size[1];
+        uint32_t shared = std::min(size[0], size[2])/side;
+        uint32_t cube = i/(side*side*side);
+        uint32_t low = cube%(shared*shared);
+        uint32_t high = cube/(shared*shared)*shared;
+        uint32_t cx = compact1by1(low) + (size[0] > size[2] ? high : 0);
+        uint32_t cz = compact1by1(low >> 1) + (size[0] > size[2] ? 0 : high);
+        mortonDecode(i%(side*side*side), x, y, z);
+        x += cx*side;
+        z += cz*side;
+    }
+};
+
+#endif
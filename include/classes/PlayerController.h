@@ -20,6 +20,8 @@ private:
     // adjust sensitivity as needed
     float sensitivity = 0.001f;
     bool lastPPress = true;
+    bool lastZPress = false;
+    bool lastYPress = false;
 
 public:
     // up direction
@@ -37,6 +39,7 @@ public:
     int brush = 0;
     bool physicsToggle = true;
     bool physicsTick = false;
+    int history = 0; // -1 to undo an edit, 1 to redo one, for the frame the shortcut was pressed.
 
     PlayerController(GLFWwindow *window) {
         posX = 512;
@@ -142,6 +145,15 @@ public:
         }
         lastPPress = pPress;
 
+        bool ctrl = glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS;
+        bool zPress = ctrl && glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+        bool yPress = ctrl && glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS;
+        history = 0;
+        if (zPress && !lastZPress) history = -1; // undo
+        else if (yPress && !lastYPress) history = 1; // redo
+        lastZPress = zPress;
+        lastYPress = yPress;
+
     }
 
     void HandleMouseInput(GLFWwindow *window) {
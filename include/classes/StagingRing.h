@@ -0,0 +1,147 @@
+#ifndef STAGINGRING_H
+#define STAGINGRING_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// glad is generated for 4.3, buffer storage is core in 4.4 (the context version we ask for), so it is loaded here.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+typedef void (APIENTRYP PFNBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// persistently mapped upload buffer, split into slots that are recycled once the GPU has finished copying out of them.
+// the CPU fills one slot while the GPU copies the previous ones, so host memory stays at the budget.
+// readback rings work the other way around, the GPU copies into a slot and the CPU reads it once its fence signals.
+class StagingRing
+{
+private:
+    std::vector<GLsync> fences;
+    std::vector<uint8_t> fallback; // used when buffer storage is missing.
+    unsigned int next = 0;
+
+    void wait(unsigned int slot) {
+        if (!fences[slot]) return;
+        while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+    }
+
+public:
+    GLuint buffer = 0;
+    size_t slotSize;
+    unsigned int slots;
+    uint8_t* mapped = nullptr;
+    bool readback;
+
+    StagingRing(size_t budget, unsigned int slotCount, bool download = false) {
+        slots = slotCount;
+        slotSize = budget/slotCount;
+        readback = download;
+        fences.assign(slots, 0);
+
+        PFNBUFFERSTORAGEPROC bufferStorage = (PFNBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        if (bufferStorage) {
+            GLbitfield flags = (readback ? GL_MAP_READ_BIT : GL_MAP_WRITE_BIT) | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage(GL_COPY_READ_BUFFER, slotSize*slots, nullptr, flags | (readback ? GL_CLIENT_STORAGE_BIT : 0));
+            mapped = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, slotSize*slots, flags));
+        }
+        if (!mapped) {
+            std::cout<<"Persistent mapping unavailable, staging through glBufferSubData"<<std::endl;
+            glBufferData(GL_COPY_READ_BUFFER, slotSize, nullptr, readback ? GL_STREAM_READ : GL_STREAM_DRAW);
+            fallback.resize(readback ? slotSize*slots : slotSize);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    ~StagingRing() {
+        finish();
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        if (mapped) glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    // next free slot (slotSize bytes), blocks until the GPU is done with it.
+    uint8_t* acquire() {
+        if (!mapped) return fallback.data();
+        wait(next);
+        return mapped + next*slotSize;
+    }
+
+    // copies size bytes at slotOffset of the acquired slot to dst at dstOffset. a slot can feed several copies.
+    void copy(GLuint dst, GLintptr dstOffset, GLsizeiptr size, size_t slotOffset = 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+        if (mapped) {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, next*slotSize + slotOffset, dstOffset, size);
+        } else {
+            glBufferSubData(GL_COPY_READ_BUFFER, 0, size, fallback.data() + slotOffset);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, dstOffset, size);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // hands the acquired slot back, it is reused once its copies have finished.
+    void release() {
+        if (!mapped) return;
+        fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush(); // start the copies now, the CPU moves on to the next slot.
+        next = (next+1) % slots;
+    }
+
+    // copies the first size bytes of the acquired slot to dst at dstOffset, and releases it.
+    void upload(GLuint dst, GLintptr dstOffset, GLsizeiptr size) {
+        copy(dst, dstOffset, size);
+        release();
+    }
+
+    // readback: copies size bytes of src at srcOffset into the next slot, returns the slot. the caller must be done reading it.
+    unsigned int download(GLuint src, GLintptr srcOffset, GLsizeiptr size) {
+        unsigned int slot = next;
+        glBindBuffer(GL_COPY_READ_BUFFER, src);
+        if (mapped) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, srcOffset, slot*slotSize, size);
+            fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        } else {
+            glGetBufferSubData(GL_COPY_READ_BUFFER, srcOffset, size, fallback.data() + slot*slotSize);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        next = (next+1) % slots;
+        return slot;
+    }
+
+    // readback: polls whether a slots copy has landed, without blocking.
+    bool ready(unsigned int slot) {
+        if (!fences[slot]) return true;
+        GLenum status = glClientWaitSync(fences[slot], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+        return true;
+    }
+
+    uint8_t* data(unsigned int slot) {
+        return (mapped ? mapped : fallback.data()) + slot*slotSize;
+    }
+
+    // waits for every pending copy.
+    void finish() {
+        for (unsigned int i = 0; i < slots; i++) wait(i);
+    }
+};
+
+#endif
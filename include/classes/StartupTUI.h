@@ -26,7 +26,7 @@ public:
             std::cout<<"It features a 1024^3 voxel environment with raytraced lighting, along with a tunable custom ambient occlusion algorithm. There is a rudimentary building system, along with a cellular automata fluid physics engine."<<std::endl; // features
             std::cout<<"\nTo play, use WASD for movement in XZ plane, space to ascend, and shift to descend."<<std::endl; // how to play
             std::cout<<"Use left and right click to place and break, and scroll wheel to resize interaction (interactions resize by doubling or halfing to ensure a uniform grid)."<<std::endl; // how to play
-            std::cout<<"Other keys include number keys for changing block type, and P for toggling physics.\n"<<std::endl; // how to play
+            std::cout<<"Other keys include number keys for changing block type, P for toggling physics, and Ctrl+Z and Ctrl+Y for undoing and redoing edits.\n"<<std::endl; // how to play
         } else if (*userInput == "settings") {
             while (true) {
             std::cout<<"\n\033[1m"<<"PUNDUS SETTINGS" <<"\033[0m"<<"\n"<<std::endl; // title
@@ -0,0 +1,102 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of threads for splitting a loop over independent items. the calling thread works through items too,
+// and run() returns once every item is done. calls from inside an item run inline, so nesting cannot deadlock.
+class WorkerPool
+{
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::mutex runMutex; // one loop at a time, other callers wait their turn.
+    const std::function<void(size_t)>* job = nullptr;
+    size_t jobCount = 0;
+    std::atomic<size_t> nextItem{0};
+    unsigned int busy = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    static inline thread_local bool inPool = false;
+
+    void drain() {
+        size_t i;
+        while ((i = nextItem++) < jobCount) (*job)(i);
+    }
+
+    void work() {
+        inPool = true;
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            drain();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0) done.notify_all();
+        }
+    }
+
+public:
+    // threadCount 0 uses every core, the calling thread being one of them.
+    WorkerPool(unsigned int threadCount = 0) {
+        if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+        for (unsigned int i = 1; i < threadCount; i++) threads.emplace_back(&WorkerPool::work, this);
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads) thread.join();
+    }
+
+    unsigned int size() const {
+        return unsigned(threads.size()) + 1;
+    }
+
+    // calls fn(i) for every i in [0, count), spread over the pool. blocks until all calls have returned.
+    void run(size_t count, const std::function<void(size_t)>& fn) {
+        if (count <= 1 || threads.empty() || inPool) {
+            for (size_t i = 0; i < count; i++) fn(i);
+            return;
+        }
+        std::lock_guard<std::mutex> runLock(runMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            jobCount = count;
+            nextItem = 0;
+            busy = unsigned(threads.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        inPool = true;
+        drain();
+        inPool = false;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busy == 0; });
+        job = nullptr;
+    }
+};
+
+#endif
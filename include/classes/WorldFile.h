@@ -0,0 +1,612 @@
+#ifndef WORLDFILE_H
+#define WORLDFILE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <classes/MappedFile.h>
+#include <classes/Morton.h>
+#include <classes/WorkerPool.h>
+
+// .pun world files.
+// v1 is a raw dump of the voxel buffer (one byte per voxel, morton ordered, no header).
+// v2 layout:
+//   header  : Header struct below.
+//   table   : brickCount BrickEntry structs, sorted by brick (morton) index. empty bricks are left out.
+//   payload : run length coded bricks, as (run, value) byte pairs, addressed by BrickEntry::offset.
+// v3 adds:
+//   mask    : the occupancy mask (one bit per brick, set when empty, as in ssbo1) at maskOffset, with a CRC32.
+// v4 adds the player position to the header, so loading can start around it.
+// v5 splits the world into segments of segmentBricks bricks (a 64^3 voxel cube in morton order), each coded on its own,
+// so they can be encoded and decoded in parallel and read without touching the rest of the file:
+//   index    : segmentCount SegmentEntry structs, right after the header.
+//   segments : per segment, brickCount BrickEntry structs then its payload, padded to 4 bytes. offsets are per segment.
+//   mask     : as in v3.
+// v6 adds the window origin to the header, the world voxel x and z that buffer voxel x and z wrap around from, for worlds
+// paged around the player (see WorldPager.h).
+// v7 adds the y and z size of the world, axisSize being x, as worlds no longer have to be cubes. voxels are in the order
+// of WorldLayout (Morton.h), plain morton order for cubes.
+// edits made after a save are appended to a journal (<path>j) instead of rewriting the whole file:
+//   header  : JournalHeader struct below, stamp must match the stamp of the world file it belongs to.
+//   batches : {uint32 count, uint32 byteSize} then count {uint32 brick, uint16 size, run length coded brick} records.
+//             a batch cut short by a crash is dropped along with anything after it. later records win.
+class WorldFile
+{
+public:
+    static const uint32_t MAGIC = 0x574E5550; // "PUNW" in little endian.
+    static const uint32_t VERSION = 7;
+    static const uint32_t JOURNAL_MAGIC = 0x4A4E5550; // "PUNJ" in little endian.
+    static const uint32_t BASE_HEADER_SIZE = 32; // size of the first v2 header, fields past headerSize read as 0.
+    static const uint32_t SEGMENT_VOXELS = 64*64*64;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t headerSize; // lets newer versions append fields.
+        uint32_t axisSize; // x size, all three before v7.
+        uint32_t passRes;
+        uint32_t brickCount;
+        uint64_t payloadSize;
+        uint64_t stamp; // identifies this save, for matching journals.
+        uint64_t maskOffset; // 0 when there is no mask.
+        uint32_t maskSize;
+        uint32_t maskChecksum;
+        float player[3];
+        uint32_t reserved;
+        uint32_t segmentCount;
+        uint32_t segmentBricks;
+        int32_t window[2];
+        uint32_t sizeY;
+        uint32_t sizeZ;
+    };
+
+    struct JournalHeader {
+        uint32_t magic;
+        uint32_t axisSize;
+        uint32_t passRes;
+        uint32_t reserved;
+        uint64_t stamp;
+    };
+
+    struct BrickEntry {
+        uint32_t brick;  // brick index, same as the occupancy mask index (cm) in the shaders.
+        uint32_t offset; // byte offset into payload.
+    };
+
+    struct SegmentEntry {
+        uint64_t offset; // file offset of the segments brick table.
+        uint32_t brickCount;
+        uint32_t payloadSize;
+    };
+
+    std::string path;
+    uint32_t size[3]; // voxels along x, y and z.
+    uint32_t passRes;
+    uint32_t brickBytes; // voxels (bytes) per brick.
+    uint64_t numBricks;
+    uint32_t segmentBricks; // bricks per segment when saving.
+    uint32_t version = 0; // version of the last opened file.
+    uint64_t stamp = 0; // stamp of the last opened or saved file, 0 for v1 files.
+    float player[3]; // player position, read by open() and written by saves. the middle of the world until then.
+    bool hasPlayer = false; // whether the opened file stored a player position.
+    int32_t window[2] = {0, 0}; // window origin (x, z), read by open() and written by saves.
+    bool quiet = false; // no message per save, for the many small region files.
+    WorkerPool pool; // encodes and decodes segments in parallel.
+
+    WorldFile(const std::string& filePath, unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ, unsigned int res) {
+        path = filePath;
+        size[0] = sizeX;
+        size[1] = sizeY;
+        size[2] = sizeZ;
+        passRes = res;
+        for (int a = 0; a < 3; a++) player[a] = float(size[a])/2.0f;
+        brickBytes = res*res*res;
+        numBricks = layout().cells()/brickBytes;
+        segmentBricks = std::max(SEGMENT_VOXELS/brickBytes, 32u); // whole mask words, so segments never share one.
+    }
+
+    WorldFile(const std::string& filePath, unsigned int axis, unsigned int res) : WorldFile(filePath, axis, axis, axis, res) {}
+
+    WorldLayout layout() const {
+        return WorldLayout(size[0], size[1], size[2]);
+    }
+
+    uint64_t rawSize() const {
+        return numBricks*brickBytes;
+    }
+
+    uint32_t segmentCount() const {
+        return uint32_t((numBricks+segmentBricks-1)/segmentBricks);
+    }
+
+    // world file contents being built up, range by range in brick order.
+    struct Segment {
+        std::vector<BrickEntry> entries;
+        std::vector<uint8_t> encoded;
+    };
+    struct Encoding {
+        std::vector<Segment> segments;
+        std::vector<uint32_t> mask;
+    };
+
+    // appends the non-empty bricks of voxels [offset, offset+size) to an encoding, one segment per pool thread.
+    // safe to call from a worker thread.
+    void encodeRange(Encoding& encoding, uint64_t offset, uint64_t size, const uint8_t* voxels) {
+        if (encoding.mask.empty()) {
+            encoding.segments.resize(segmentCount());
+            encoding.mask.assign(maskWords(), 0xFFFFFFFFu);
+        }
+        uint64_t first = offset/brickBytes;
+        uint64_t last = first + size/brickBytes;
+        if (last <= first) return;
+        uint64_t firstSegment = first/segmentBricks;
+        pool.run((last-1)/segmentBricks + 1 - firstSegment, [&](size_t i) {
+            uint64_t s = firstSegment+i;
+            Segment& segment = encoding.segments[s];
+            std::vector<uint8_t> scratch(2*brickBytes); // worst case, every voxel its own run.
+            for (uint64_t b = std::max(first, s*segmentBricks); b < std::min(last, (s+1)*segmentBricks); b++) {
+                const uint8_t* brick = voxels + (b-first)*brickBytes;
+                if (brickEmpty(brick)) continue;
+                encoding.mask[b >> 5] &= ~(1u << (b & 31u));
+                size_t length = encodeBrick(brick, scratch.data());
+                segment.entries.push_back({uint32_t(b), uint32_t(segment.encoded.size())});
+                segment.encoded.insert(segment.encoded.end(), scratch.begin(), scratch.begin()+length);
+            }
+        });
+    }
+
+    // writes a finished encoding as the new world file in the current format.
+    bool write(const Encoding& encoding) {
+        if (!beginWrite()) return false;
+        for (const Segment& segment : encoding.segments) appendSegment(segment);
+        return finishWrite(encoding.mask);
+    }
+
+    // streamed writing, for worlds that do not fit in memory: beginWrite(), then writeRange() over the voxels
+    // in order, then endWrite(). only the segments of the range being written are held in memory.
+    bool beginWrite() {
+        outFile.close();
+        outFile.clear();
+        pending = Encoding();
+        writeIndex.assign(segmentCount(), SegmentEntry{});
+        writeAt = sizeof(Header) + writeIndex.size()*sizeof(SegmentEntry);
+        writeSegments = 0;
+        writeBricks = 0;
+
+        // written next to the old file and swapped in, so a failed save leaves the old world intact.
+        // header and index are filled in once every segment is written.
+        outFile.open(tmpPath(), std::ios::binary | std::ios::trunc);
+        std::vector<char> zeros(writeAt, 0);
+        outFile.write(zeros.data(), zeros.size());
+        return bool(outFile);
+    }
+
+    // encodes voxels [offset, offset+size), following on from the previous range, and writes the segments it completes.
+    bool writeRange(uint64_t offset, uint64_t size, const uint8_t* voxels) {
+        encodeRange(pending, offset, size, voxels);
+        uint64_t complete = (offset+size)/brickBytes/segmentBricks;
+        if (offset+size == rawSize()) complete = segmentCount();
+        while (writeSegments < complete) {
+            appendSegment(pending.segments[writeSegments]);
+            pending.segments[writeSegments-1] = Segment(); // written, free it.
+        }
+        return bool(outFile);
+    }
+
+    bool endWrite() {
+        while (writeSegments < segmentCount()) appendSegment(Segment());
+        bool written = finishWrite(pending.mask);
+        pending = Encoding();
+        return written;
+    }
+
+    // drops a streamed write, leaving the old world file as it was.
+    void abortWrite() {
+        outFile.close();
+        pending = Encoding();
+        writeIndex = std::vector<SegmentEntry>();
+        std::error_code ec;
+        std::filesystem::remove(tmpPath(), ec);
+    }
+
+    // saves voxel buffer contents (rawSize() bytes) in the current format.
+    bool save(const uint32_t* voxels) {
+        Encoding encoding;
+        encodeRange(encoding, 0, rawSize(), reinterpret_cast<const uint8_t*>(voxels));
+        return write(encoding);
+    }
+
+    std::string journalPath() const {
+        return path + "j";
+    }
+
+    uint64_t journalSize() const {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(journalPath(), ec);
+        return ec ? 0 : size;
+    }
+
+    // appends count records (brick index, then brickBytes of voxels) to the journal as one batch.
+    bool appendJournal(const uint32_t* records, uint32_t count) {
+        if (count == 0) return true;
+        const uint32_t recordUints = 1 + brickBytes/4;
+        std::vector<uint8_t> batch(2*sizeof(uint32_t));
+        std::vector<uint8_t> scratch(2*brickBytes);
+        for (uint32_t i = 0; i < count; i++) {
+            const uint32_t* record = records + uint64_t(i)*recordUints;
+            uint16_t size = uint16_t(encodeBrick(reinterpret_cast<const uint8_t*>(record+1), scratch.data()));
+            size_t at = batch.size();
+            batch.resize(at + sizeof(uint32_t) + sizeof(uint16_t) + size);
+            std::memcpy(&batch[at], &record[0], sizeof(uint32_t));
+            std::memcpy(&batch[at+sizeof(uint32_t)], &size, sizeof(uint16_t));
+            std::memcpy(&batch[at+sizeof(uint32_t)+sizeof(uint16_t)], scratch.data(), size);
+        }
+        uint32_t byteSize = uint32_t(batch.size() - 2*sizeof(uint32_t));
+        std::memcpy(&batch[0], &count, sizeof(uint32_t));
+        std::memcpy(&batch[sizeof(uint32_t)], &byteSize, sizeof(uint32_t));
+
+        // start a fresh journal if there is none for the current world file.
+        JournalHeader header = {};
+        std::ifstream inFile(journalPath(), std::ios::binary);
+        inFile.read(reinterpret_cast<char*>(&header), sizeof(JournalHeader));
+        bool fresh = !inFile || header.magic != JOURNAL_MAGIC || header.stamp != stamp;
+        inFile.close();
+
+        std::ofstream outFile(journalPath(), std::ios::binary | (fresh ? std::ios::trunc : std::ios::app));
+        if (!outFile) return false;
+        if (fresh) {
+            header = {JOURNAL_MAGIC, size[0], passRes, 0, stamp};
+            outFile.write(reinterpret_cast<const char*>(&header), sizeof(JournalHeader));
+        }
+        outFile.write(reinterpret_cast<const char*>(batch.data()), batch.size());
+        outFile.close();
+        return bool(outFile);
+    }
+
+    // rewrites the player position and window in the world file header in place, journal saves leave the rest of the
+    // file alone. files from before v4 have nowhere to keep them.
+    bool writePosition() {
+        std::fstream outFile(path, std::ios::binary | std::ios::in | std::ios::out);
+        Header header = {};
+        outFile.read(reinterpret_cast<char*>(&header), BASE_HEADER_SIZE);
+        if (!outFile || header.magic != MAGIC) return false;
+        if (header.headerSize >= offsetof(Header, player) + sizeof(player) && header.version >= 4) {
+            outFile.seekp(offsetof(Header, player));
+            outFile.write(reinterpret_cast<const char*>(player), sizeof(player));
+        }
+        if (header.headerSize >= offsetof(Header, window) + sizeof(window) && header.version >= 6) {
+            outFile.seekp(offsetof(Header, window));
+            outFile.write(reinterpret_cast<const char*>(window), sizeof(window));
+        }
+        outFile.close();
+        return bool(outFile);
+    }
+
+    // maps a world file of any version for reading with readRange().
+    bool open() {
+        close();
+        if (!file.open(path)) return false;
+
+        Header header = {};
+        if (file.size >= BASE_HEADER_SIZE) std::memcpy(&header, file.data, BASE_HEADER_SIZE);
+        if (header.magic != MAGIC) {
+            // no header, raw v1 dump.
+            if (file.size != rawSize()) {
+                std::cout<<"Unrecognized world file: "<<path<<std::endl;
+                close();
+                return false;
+            }
+            version = 1;
+            stamp = 0;
+            hasPlayer = false;
+            window[0] = window[1] = 0;
+            loadJournal();
+            return true;
+        }
+
+        if (header.headerSize > BASE_HEADER_SIZE && file.size >= header.headerSize) std::memcpy(&header, file.data, std::min<size_t>(header.headerSize, sizeof(Header)));
+        if (header.version < 7) {
+            header.sizeY = header.axisSize;
+            header.sizeZ = header.axisSize;
+        }
+        if (header.axisSize != size[0] || header.sizeY != size[1] || header.sizeZ != size[2] || header.passRes != passRes) {
+            std::cout<<"World was saved as "<<header.axisSize<<"x"<<header.sizeY<<"x"<<header.sizeZ<<" with pass resolution "<<header.passRes<<", expected "<<size[0]<<"x"<<size[1]<<"x"<<size[2]<<" and "<<passRes<<std::endl;
+            close();
+            return false;
+        }
+        if (header.version < 5) {
+            // one big segment, the brick table right after the header.
+            header.segmentCount = 1;
+            header.segmentBricks = uint32_t(numBricks);
+            singleSegment = {header.headerSize, header.brickCount, uint32_t(header.payloadSize)};
+            if (header.payloadSize > UINT32_MAX) header.segmentCount = 0; // fails the checks below.
+        }
+        // v5 payloadSize covers the segments brick tables as well.
+        uint64_t indexSize = header.version < 5 ? 0 : uint64_t(header.segmentCount)*sizeof(SegmentEntry);
+        uint64_t tableSize = header.version < 5 ? uint64_t(header.brickCount)*sizeof(BrickEntry) : 0;
+        if (header.headerSize < BASE_HEADER_SIZE || header.headerSize%4 != 0 || header.segmentBricks == 0
+            || header.segmentCount != (numBricks+header.segmentBricks-1)/header.segmentBricks
+            || header.headerSize+indexSize+tableSize+header.payloadSize > file.size) {
+            std::cout<<"Truncated world file: "<<path<<std::endl;
+            close();
+            return false;
+        }
+        version = header.version;
+        segments = header.version < 5 ? &singleSegment : reinterpret_cast<const SegmentEntry*>(file.data + header.headerSize);
+        fileSegmentBricks = header.segmentBricks;
+        stamp = header.stamp;
+        if (header.maskSize == maskWords()*sizeof(uint32_t) && header.maskOffset+header.maskSize <= file.size) {
+            mask = file.data + header.maskOffset;
+            maskChecksum = header.maskChecksum;
+        }
+        hasPlayer = header.version >= 4;
+        if (hasPlayer) std::memcpy(player, header.player, sizeof(player));
+        window[0] = header.version >= 6 ? header.window[0] : 0;
+        window[1] = header.version >= 6 ? header.window[1] : 0;
+        loadJournal();
+        return true;
+    }
+
+    void close() {
+        file.close();
+        overlay.clear();
+        mask = nullptr;
+        segments = nullptr;
+        fileSegmentBricks = 0;
+    }
+
+    // decodes voxels [offset, offset+size) of an opened file into dst. both must be whole bricks.
+    bool readRange(uint64_t offset, uint64_t size, uint8_t* dst) {
+        if (!file.data || offset%brickBytes != 0 || size%brickBytes != 0 || offset+size > rawSize()) return false;
+        uint64_t first = offset/brickBytes;
+        uint64_t last = (offset+size)/brickBytes;
+        if (version == 1) {
+            file.prefetch(offset+size, size); // next slice, for sequential readers.
+            std::memcpy(dst, file.data+offset, size);
+        } else if (last > first) {
+            // segments overlapping the range, one per pool thread.
+            uint64_t firstSegment = first/fileSegmentBricks;
+            std::atomic<bool> valid{true};
+            pool.run((last-1)/fileSegmentBricks + 1 - firstSegment, [&](size_t i) {
+                if (!readSegment(firstSegment+i, first, last, dst)) valid = false;
+            });
+            if (!valid) return false;
+        }
+
+        // journaled bricks replace the world file ones.
+        for (auto it = overlay.lower_bound(uint32_t(first)); it != overlay.end() && it->first < last; it++) {
+            std::memcpy(dst + (it->first-first)*brickBytes, it->second.data(), brickBytes);
+        }
+        return true;
+    }
+
+    uint64_t maskWords() const {
+        return (numBricks+31)/32;
+    }
+
+    // copies the stored occupancy mask (maskWords() uints) of an opened file, with journaled bricks applied.
+    // fails when the file has no mask or it does not match its checksum, the mask then has to be rebuilt.
+    bool readMask(uint32_t* dst) const {
+        if (!mask) return false;
+        if (crc32(mask, maskWords()*sizeof(uint32_t)) != maskChecksum) {
+            std::cout<<"Occupancy mask checksum mismatch, rebuilding"<<std::endl;
+            return false;
+        }
+        std::memcpy(dst, mask, maskWords()*sizeof(uint32_t));
+        for (auto& entry : overlay) {
+            uint32_t bit = 1u << (entry.first & 31u);
+            if (brickEmpty(entry.second.data())) dst[entry.first >> 5] |= bit;
+            else dst[entry.first >> 5] &= ~bit;
+        }
+        return true;
+    }
+
+    // loads a whole file into voxels (rawSize() bytes).
+    bool load(uint32_t* voxels) {
+        bool loaded = open() && readRange(0, rawSize(), reinterpret_cast<uint8_t*>(voxels));
+        close();
+        return loaded;
+    }
+
+    bool brickEmpty(const uint8_t* brick) const {
+        const uint32_t* words = reinterpret_cast<const uint32_t*>(brick);
+        for (uint32_t i = 0; i < brickBytes/4; i++) {
+            if (words[i] != 0u) return false;
+        }
+        return true;
+    }
+
+    // run length codes one brick into out (at most 2*brickBytes), returns encoded size.
+    size_t encodeBrick(const uint8_t* brick, uint8_t* out) const {
+        size_t size = 0;
+        uint32_t i = 0;
+        while (i < brickBytes) {
+            uint8_t value = brick[i];
+            uint32_t run = 1;
+            while (i+run < brickBytes && run < 255 && brick[i+run] == value) run++;
+            out[size++] = uint8_t(run);
+            out[size++] = value;
+            i += run;
+        }
+        return size;
+    }
+
+    // decodes one brick, fails on runs that do not exactly fill the brick.
+    bool decodeBrick(const uint8_t* in, size_t size, uint8_t* brick) const {
+        uint32_t filled = 0;
+        for (size_t i = 0; i+1 < size; i += 2) {
+            uint32_t run = in[i];
+            if (run == 0 || filled+run > brickBytes) return false;
+            std::memset(brick+filled, in[i+1], run);
+            filled += run;
+        }
+        return filled == brickBytes;
+    }
+
+private:
+    std::string tmpPath() const {
+        return path + ".tmp";
+    }
+
+    // writes the next segment after the ones already written.
+    void appendSegment(const Segment& segment) {
+        const char padding[4] = {};
+        writeIndex[writeSegments++] = {writeAt, uint32_t(segment.entries.size()), uint32_t(segment.encoded.size())};
+        outFile.write(reinterpret_cast<const char*>(segment.entries.data()), segment.entries.size()*sizeof(BrickEntry));
+        outFile.write(reinterpret_cast<const char*>(segment.encoded.data()), segment.encoded.size());
+        outFile.write(padding, (4 - segment.encoded.size()%4)%4);
+        writeAt += segment.entries.size()*sizeof(BrickEntry) + (segment.encoded.size()+3)/4*4;
+        writeBricks += segment.entries.size();
+    }
+
+    // appends the mask, fills in header and index, and swaps the file in.
+    bool finishWrite(const std::vector<uint32_t>& mask) {
+        std::random_device rd;
+        uint64_t newStamp = (uint64_t(rd()) << 32) | rd() | 1u; // never 0.
+        uint64_t payloadSize = writeAt - sizeof(Header) - writeIndex.size()*sizeof(SegmentEntry);
+        uint32_t maskSize = uint32_t(mask.size()*sizeof(uint32_t));
+        uint32_t maskChecksum = crc32(reinterpret_cast<const uint8_t*>(mask.data()), maskSize);
+        Header header = {MAGIC, VERSION, sizeof(Header), size[0], passRes, uint32_t(writeBricks), payloadSize, newStamp, maskSize ? writeAt : 0, maskSize, maskChecksum, {player[0], player[1], player[2]}, 0, uint32_t(writeIndex.size()), segmentBricks, {window[0], window[1]}, size[1], size[2]};
+
+        outFile.write(reinterpret_cast<const char*>(mask.data()), maskSize);
+        outFile.seekp(0);
+        outFile.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        outFile.write(reinterpret_cast<const char*>(writeIndex.data()), writeIndex.size()*sizeof(SegmentEntry));
+        outFile.close();
+        writeIndex = std::vector<SegmentEntry>();
+        std::error_code ec;
+        if (!outFile || writeSegments != segmentCount() || !replaceFile(tmpPath(), path)) {
+            std::filesystem::remove(tmpPath(), ec);
+            return false;
+        }
+
+        // the journal only applies to the old stamp, and everything in it is now part of the world file.
+        stamp = newStamp;
+        std::filesystem::remove(journalPath(), ec);
+
+        if (!quiet) std::cout<<"Saved "<<writeBricks<<" of "<<numBricks<<" bricks ("<<(writeAt+maskSize)/(1024*1024)<<" MiB)"<<std::endl;
+        return true;
+    }
+
+    // decodes bricks [first, last) of one segment into dst, which starts at brick first.
+    bool readSegment(uint64_t s, uint64_t first, uint64_t last, uint8_t* dst) const {
+        const SegmentEntry& segment = segments[s];
+        uint64_t from = std::max(first, s*fileSegmentBricks);
+        uint64_t to = std::min(last, (s+1)*fileSegmentBricks);
+        std::memset(dst + (from-first)*brickBytes, 0, (to-from)*brickBytes);
+        uint64_t tableSize = uint64_t(segment.brickCount)*sizeof(BrickEntry);
+        if (segment.offset%4 != 0 || segment.offset+tableSize+segment.payloadSize > file.size) return false;
+        const BrickEntry* table = reinterpret_cast<const BrickEntry*>(file.data + segment.offset);
+        const BrickEntry* tableEnd = table + segment.brickCount;
+        const uint8_t* payload = file.data + segment.offset + tableSize;
+
+        // first table entry at or after the range start.
+        const BrickEntry* entry = std::lower_bound(table, tableEnd, from, [](const BrickEntry& e, uint64_t b) { return e.brick < b; });
+        for (; entry != tableEnd && entry->brick < to; entry++) {
+            uint64_t end = (entry+1 != tableEnd) ? entry[1].offset : segment.payloadSize;
+            if (end < entry->offset || end > segment.payloadSize) return false;
+            if (!decodeBrick(payload+entry->offset, end-entry->offset, dst + (entry->brick-first)*brickBytes)) return false;
+        }
+        return true;
+    }
+
+    // reads the journal of the opened world file into overlay.
+    void loadJournal() {
+        overlay.clear();
+        std::ifstream inFile(journalPath(), std::ios::binary);
+        JournalHeader header = {};
+        inFile.read(reinterpret_cast<char*>(&header), sizeof(JournalHeader));
+        if (!inFile || header.magic != JOURNAL_MAGIC) return;
+        if (header.stamp != stamp || header.axisSize != size[0] || header.passRes != passRes) {
+            std::cout<<"Ignoring journal that does not match world file: "<<journalPath()<<std::endl;
+            return;
+        }
+
+        uint32_t batches = 0;
+        std::vector<uint8_t> batch;
+        while (true) {
+            uint32_t count = 0, byteSize = 0;
+            inFile.read(reinterpret_cast<char*>(&count), sizeof(uint32_t));
+            inFile.read(reinterpret_cast<char*>(&byteSize), sizeof(uint32_t));
+            if (!inFile) break;
+            batch.resize(byteSize);
+            inFile.read(reinterpret_cast<char*>(batch.data()), byteSize);
+            if (!inFile) break; // cut short.
+
+            // decode into a temporary map first, so a corrupt batch is dropped whole.
+            std::map<uint32_t, std::vector<uint8_t>> decoded;
+            size_t at = 0;
+            bool valid = true;
+            for (uint32_t i = 0; i < count && valid; i++) {
+                uint32_t brick;
+                uint16_t size;
+                if (at+sizeof(uint32_t)+sizeof(uint16_t) > batch.size()) { valid = false; break; }
+                std::memcpy(&brick, &batch[at], sizeof(uint32_t));
+                std::memcpy(&size, &batch[at+sizeof(uint32_t)], sizeof(uint16_t));
+                at += sizeof(uint32_t)+sizeof(uint16_t);
+                std::vector<uint8_t> voxels(brickBytes);
+                valid = brick < numBricks && at+size <= batch.size() && decodeBrick(&batch[at], size, voxels.data());
+                decoded[brick] = std::move(voxels);
+                at += size;
+            }
+            if (!valid) break;
+            for (auto& entry : decoded) overlay[entry.first] = std::move(entry.second);
+            batches++;
+        }
+        if (batches > 0) std::cout<<"Applying "<<overlay.size()<<" journaled bricks from "<<batches<<" saves"<<std::endl;
+    }
+
+    static uint32_t crc32(const uint8_t* data, size_t size) {
+        static const std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> t;
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) c = (c & 1u) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8);
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    static bool replaceFile(const std::string& from, const std::string& to) {
+        std::error_code ec;
+        std::filesystem::rename(from, to, ec);
+        if (ec) { // some platforms refuse to rename over an existing file.
+            std::filesystem::remove(to, ec);
+            std::filesystem::rename(from, to, ec);
+        }
+        return !ec;
+    }
+
+    std::map<uint32_t, std::vector<uint8_t>> overlay; // journaled bricks, by brick index.
+    const uint8_t* mask = nullptr; // stored occupancy mask of the opened file.
+    uint32_t maskChecksum = 0;
+    MappedFile file;
+    const SegmentEntry* segments = nullptr; // index of the opened file.
+    SegmentEntry singleSegment = {}; // stands in for the index of v2 to v4 files.
+    uint64_t fileSegmentBricks = 0; // bricks per segment of the opened file.
+
+    // file being written.
+    std::ofstream outFile;
+    Encoding pending; // streamed ranges not written out yet.
+    std::vector<SegmentEntry> writeIndex;
+    uint64_t writeAt = 0;
+    uint32_t writeSegments = 0;
+    uint64_t writeBricks = 0;
+};
+
+#endif
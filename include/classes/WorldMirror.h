@@ -0,0 +1,118 @@
+#ifndef WORLDMIRROR_H
+#define WORLDMIRROR_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <classes/GLshader.h>
+#include <classes/StagingRing.h>
+#include <classes/WorldVolume.h>
+
+// keeps a WorldVolume in step with the voxel buffer, without stalling on it. passes that write voxels set the brick's
+// bit in a dirty mask (binding 16, mirrorDirty in each shader), and once a frame the gather pass packs dirty bricks
+// into delta records (binding 17) that are read back through a small readback ring and applied when they land.
+// records are a brick index and its 16 uints, or for air and uniform bricks the index tagged UNIFORM and a material.
+// bricks that do not fit in a round stay dirty for the next one, so the host lags a frame or two behind.
+class WorldMirror
+{
+private:
+    WorldVolume& volume;
+    Shader& gatherShader;
+    StagingRing ring;
+    std::vector<bool> pending; // ring slots whose gather has not landed yet.
+    uint64_t dirtyWords;
+    uint32_t capacity; // record words per round.
+    uint32_t lastWords = 0xFFFFFFFFu; // words the last landed round wanted, 0 once nothing was dirty.
+    unsigned int issueSlot = 0; // slot the ring copies into next.
+    unsigned int landSlot = 0; // oldest slot still copying, slots land in order.
+
+    // applies the rounds that have landed, in order.
+    void land() {
+        while (pending[landSlot] && ring.ready(landSlot)) {
+            const uint32_t* data = reinterpret_cast<const uint32_t*>(ring.data(landSlot));
+            lastWords = data[0];
+            volume.apply(data+1, std::min(data[0], capacity));
+            pending[landSlot] = false;
+            landSlot = (landSlot+1) % ring.slots;
+        }
+    }
+
+    void gather() {
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, deltas);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        gatherShader.use();
+        gatherShader.setInt("capacity", int(capacity));
+        glDispatchCompute(GLuint((dirtyWords+63)/64), 1, 1);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT); // shader writes visible to the copy.
+        ring.download(deltas, 0, ring.slotSize);
+        pending[issueSlot] = true;
+        issueSlot = (issueSlot+1) % ring.slots;
+    }
+
+public:
+    GLuint dirty = 0;
+    GLuint deltas = 0;
+
+    WorldMirror(WorldVolume& vol, size_t budget, unsigned int slots, Shader& gather)
+        : volume(vol), gatherShader(gather), ring(budget, slots, true) {
+        pending.assign(slots, false);
+        dirtyWords = volume.numBricks/32;
+        capacity = uint32_t(ring.slotSize/sizeof(GLuint)) - 1;
+
+        glGenBuffers(1, &dirty);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, dirty);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint)*dirtyWords, nullptr, GL_DYNAMIC_DRAW);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 16, dirty);
+        glGenBuffers(1, &deltas);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, deltas);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, ring.slotSize, nullptr, GL_DYNAMIC_READ);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 17, deltas);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    ~WorldMirror() {
+        ring.finish();
+        glDeleteBuffers(1, &dirty);
+        glDeleteBuffers(1, &deltas);
+    }
+
+    // has every brick sent again, for a world generated on the GPU. air bricks the host already has as air are
+    // sent too, the first frames of a new world catch up a ring slot at a time.
+    void markAll() {
+        GLuint ones = 0xFFFFFFFFu;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, dirty);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &ones);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        lastWords = 0xFFFFFFFFu;
+    }
+
+    // applies the rounds that landed and starts the next one if a ring slot is free. never blocks.
+    void update() {
+        land();
+        if (!pending[issueSlot]) gather();
+    }
+
+    // true once a round found nothing dirty and nothing is in flight, the volume then matches the GPU.
+    bool synced() const {
+        return lastWords == 0 && std::count(pending.begin(), pending.end(), true) == 0;
+    }
+
+    // blocks until the volume matches the GPU, for saving.
+    void sync() {
+        while (true) {
+            ring.finish();
+            land();
+            if (synced()) return;
+            gather();
+        }
+    }
+};
+
+#endif
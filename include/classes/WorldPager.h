@@ -0,0 +1,393 @@
+#ifndef WORLDPAGER_H
+#define WORLDPAGER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <classes/BrickPool.h>
+#include <classes/GLshader.h>
+#include <classes/Morton.h>
+#include <classes/StagingRing.h>
+#include <classes/WorldFile.h>
+
+// makes the world endless along x and z. the voxel buffer is a window onto the world that follows the player, and
+// since indices wrap around the buffer (see WorldLayout in Morton.h), world voxel x lives at buffer voxel x mod its
+// width without anything ever having to move. the window is split into full height columns of columnAxis voxels, and
+// columns the window leaves behind are written to region files (a world file per columnAxis^3 cube) while the columns
+// it enters in front take their place, read back from their region files or generated by the terrain shader when never
+// visited.
+// columns are paged a few per frame without stalling the frame. a column going out is copied out densely and read back through
+// a readback ring, a thread writes it to its region files once it lands and then reads the region files of the column
+// coming in, and the render thread uploads those through an upload ring a frame or so later. the thread works through
+// columns in order, so a region written by one column is there for a later column reading it back.
+// undo snapshots and the save journal refer to buffer bricks, so once a column is paged the caller has to drop the edit
+// history and make the next save a full one (moved is set).
+class WorldPager
+{
+private:
+    enum JobState { COPYING, QUEUED, READY };
+
+    // a buffer column on its way from one world column to another.
+    struct Job {
+        uint32_t bx, bz;
+        int32_t from[2]; // world column written out.
+        int32_t to[2]; // world column read in.
+        unsigned int slot; // readback ring slot.
+        std::vector<bool> stored; // cubes with a region file, filled in by the thread.
+        bool visited = true; // every cube had one.
+        std::vector<uint32_t> records; // {brick index, brick uints} records of the stored cubes.
+        std::atomic<int> state{COPYING};
+    };
+
+    BrickPool& bricks;
+    Shader& terrainShader;
+    Shader& maskShader;
+    WorldFile regionFile; // every region file goes through this one on the thread, its path changes.
+    std::string regionDir;
+    StagingRing readback; // a column per slot.
+    StagingRing upload; // records of a column per slot, as far as the stage buffer takes them.
+    GLuint denseBuffer; // a column per readback slot.
+    WorldLayout cubeLayout; // the buffer in columnAxis^3 cubes.
+    uint32_t size[3]; // voxels along x, y and z.
+    uint32_t passRes;
+    uint32_t columnAxis;
+    uint32_t columns[2]; // along x and z in the window.
+    uint32_t cubes; // per column.
+    uint64_t cubeBricks;
+    uint64_t recordUints; // brick index then the brick.
+    std::vector<int32_t> held; // world column (x, z) each buffer column holds.
+    std::vector<bool> paging; // buffer columns with a job in flight.
+    std::deque<std::unique_ptr<Job>> jobs; // in flight, oldest first.
+    unsigned int nextSlot = 0; // dense buffer slot, in step with the readback ring.
+
+    // thread
+    std::vector<uint8_t> cube; // a region being read.
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable done;
+    std::deque<Job*> queue; // nullptr stops the thread.
+
+    static int32_t floorDiv(int32_t a, int32_t b) {
+        return a >= 0 ? a/b : -((-a+b-1)/b);
+    }
+
+    static int32_t posMod(int32_t a, int32_t b) {
+        return a - floorDiv(a, b)*b;
+    }
+
+    // world column a buffer column holds once the window is at origin, a is 0 for x and 1 for z.
+    int32_t target(uint32_t b, int a) const {
+        return origin[a] + posMod(int32_t(b) - origin[a], int32_t(columns[a]));
+    }
+
+    uint64_t cubeFirst(uint32_t bx, uint32_t cy, uint32_t bz) const {
+        return uint64_t(cubeLayout.index(bx, cy, bz))*cubeBricks;
+    }
+
+    std::string regionPath(int32_t x, uint32_t y, int32_t z) const {
+        return regionDir + "/r." + std::to_string(x) + "." + std::to_string(y) + "." + std::to_string(z) + ".pun";
+    }
+
+    void push(Job* job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(job);
+        }
+        cv.notify_one();
+    }
+
+    void work() {
+        while (true) {
+            Job* job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return !queue.empty(); });
+                job = queue.front();
+                queue.pop_front();
+            }
+            if (!job) break;
+            save(*job);
+            read(*job);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job->state = READY;
+            }
+            done.notify_all();
+        }
+    }
+
+    // thread: writes the landed column to its region files. the segments of a region are encoded on the region files pool.
+    void save(Job& job) {
+        uint64_t cubeBytes = regionFile.rawSize();
+        const uint8_t* column = readback.data(job.slot);
+
+        // all air cubes are written too, a missing region file means never visited.
+        std::error_code ec;
+        std::filesystem::create_directories(regionDir, ec);
+        for (uint32_t cy = 0; cy < cubes; cy++) {
+            regionFile.path = regionPath(job.from[0], cy, job.from[1]);
+            if (!regionFile.save(reinterpret_cast<const uint32_t*>(column + cy*cubeBytes))) std::cout<<"Failed to write region: "<<regionFile.path<<std::endl;
+        }
+    }
+
+    // thread: reads the region files of the incoming column into records, air bricks left out.
+    void read(Job& job) {
+        job.stored.assign(cubes, false);
+        job.visited = true;
+        job.records.clear();
+        for (uint32_t cy = 0; cy < cubes; cy++) {
+            std::error_code ec;
+            regionFile.path = regionPath(job.to[0], cy, job.to[1]);
+            if (!std::filesystem::exists(regionFile.path, ec)) {
+                job.visited = false;
+                continue;
+            }
+            bool read = regionFile.open() && regionFile.readRange(0, regionFile.rawSize(), cube.data());
+            regionFile.close();
+            if (!read) {
+                std::cout<<"Failed to read region: "<<regionFile.path<<std::endl;
+                continue;
+            }
+            job.stored[cy] = true;
+
+            uint64_t first = cubeFirst(job.bx, cy, job.bz);
+            for (uint64_t b = 0; b < cubeBricks; b++) {
+                const uint8_t* brick = cube.data() + b*regionFile.brickBytes;
+                if (regionFile.brickEmpty(brick)) continue;
+                job.records.push_back(uint32_t(first+b));
+                job.records.insert(job.records.end(), reinterpret_cast<const uint32_t*>(brick), reinterpret_cast<const uint32_t*>(brick)+recordUints-1);
+            }
+        }
+    }
+
+    // copies the column at buffer column (bx, bz) out for the thread, and takes it out of the window.
+    void evict(uint32_t bx, uint32_t bz) {
+        std::unique_ptr<Job> job(new Job());
+        uint32_t slot = bz*columns[0] + bx;
+        job->bx = bx;
+        job->bz = bz;
+        job->from[0] = held[slot*2];
+        job->from[1] = held[slot*2+1];
+        job->to[0] = target(bx, 0);
+        job->to[1] = target(bz, 1);
+
+        // jobs finish in order and never outnumber the slots, so the slot download() picks is always free.
+        uint64_t cubeBytes = regionFile.rawSize();
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        uint64_t denseOffset = uint64_t(nextSlot)*readback.slotSize;
+        for (uint32_t cy = 0; cy < cubes; cy++) bricks.densify(cubeFirst(bx, cy, bz), cubeBricks, denseBuffer, denseOffset + cy*cubeBytes);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT); // shader writes visible to the copy.
+        job->slot = readback.download(denseBuffer, denseOffset, cubes*cubeBytes);
+        nextSlot = (nextSlot+1) % readback.slots;
+
+        paging[slot] = true;
+        moved = true;
+        jobs.push_back(std::move(job));
+    }
+
+    // fills buffer column (bx, bz) with what the thread read for it.
+    void load(Job& job) {
+        for (uint32_t cy = 0; cy < cubes; cy++) bricks.clear(cubeFirst(job.bx, cy, job.bz), cubeBricks);
+
+        if (!job.visited) {
+            terrainShader.use();
+            terrainShader.setInt("bufX", int(job.bx*columnAxis));
+            terrainShader.setInt("bufZ", int(job.bz*columnAxis));
+            terrainShader.setInt("worldX", job.to[0]*int32_t(columnAxis));
+            terrainShader.setInt("worldZ", job.to[1]*int32_t(columnAxis));
+            glDispatchCompute(columnAxis/4, size[1]/4, columnAxis/4);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            // stored cubes replace whatever was generated, air bricks included.
+            for (uint32_t cy = 0; cy < cubes; cy++) {
+                if (job.stored[cy]) bricks.clear(cubeFirst(job.bx, cy, job.bz), cubeBricks);
+            }
+        }
+
+        // records go up a ring slot at a time, each slot scattered straight from the stage buffer.
+        uint64_t recordBytes = recordUints*sizeof(uint32_t);
+        uint64_t slotRecords = upload.slotSize/recordBytes;
+        uint64_t count = job.records.size()/recordUints;
+        for (uint64_t r = 0; r < count; r += slotRecords) {
+            uint64_t batch = std::min(slotRecords, count-r);
+            std::memcpy(upload.acquire(), job.records.data() + r*recordUints, batch*recordBytes);
+            upload.upload(bricks.stage, 0, batch*recordBytes);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            bricks.scatter(uint32_t(batch));
+        }
+
+        // the mask of the whole column, one thread per brick.
+        maskShader.use();
+        maskShader.setInt("cPPosX", int(job.bx*columnAxis/passRes));
+        maskShader.setInt("cPPosZ", int(job.bz*columnAxis/passRes));
+        glDispatchCompute(columnAxis/(4*passRes), size[1]/(4*passRes), columnAxis/(4*passRes));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        uint32_t slot = job.bz*columns[0] + job.bx;
+        held[slot*2] = job.to[0];
+        held[slot*2+1] = job.to[1];
+        paging[slot] = false;
+        moved = true;
+    }
+
+    // blocks until the oldest job in flight can move on.
+    void wait() {
+        if (jobs.empty()) return;
+        Job& job = *jobs.front();
+        if (job.state == COPYING) {
+            readback.finish();
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&job] { return job.state == READY; });
+    }
+
+public:
+    int32_t origin[2] = {0, 0}; // world column at the low corner of the window, where it is heading.
+    int32_t loaded[2] = {0, 0}; // where it was when every column was last in.
+    bool moved = false; // a column was paged, cleared by the caller.
+
+    // slots is the number of columns in flight between the GPU copies and the region file thread.
+    WorldPager(const std::string& worldPath, BrickPool& pool, Shader& terrain, Shader& mask, unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ, unsigned int res, unsigned int slots, unsigned int columnSize = 64)
+        : bricks(pool), terrainShader(terrain), maskShader(mask), regionFile("", columnSize, res),
+          readback(uint64_t(sizeY)*columnSize*columnSize*slots, slots, true),
+          upload(std::min<uint64_t>(uint64_t(sizeY)*columnSize*columnSize/(res*res*res)*(4 + res*res*res), pool.stageSize)*slots, slots),
+          cubeLayout(sizeX/columnSize, sizeY/columnSize, sizeZ/columnSize) {
+        regionDir = std::filesystem::path(worldPath).replace_extension(".regions").string();
+        regionFile.quiet = true;
+        size[0] = sizeX;
+        size[1] = sizeY;
+        size[2] = sizeZ;
+        passRes = res;
+        columnAxis = columnSize;
+        columns[0] = sizeX/columnAxis;
+        columns[1] = sizeZ/columnAxis;
+        cubes = sizeY/columnAxis;
+        cubeBricks = regionFile.numBricks;
+        recordUints = 1 + regionFile.brickBytes/4;
+        cube.resize(regionFile.rawSize());
+
+        glGenBuffers(1, &denseBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, denseBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, readback.slotSize*readback.slots, nullptr, GL_STREAM_COPY);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        start(0, 0);
+        worker = std::thread(&WorldPager::work, this);
+    }
+
+    // columns still copying are dropped, drain() first to keep them.
+    ~WorldPager() {
+        push(nullptr);
+        worker.join();
+        glDeleteBuffers(1, &denseBuffer);
+    }
+
+    // takes the buffer as holding the window at (windowX, windowZ), in world voxels, as stored in the world file.
+    // nothing may be in flight.
+    void start(int32_t windowX, int32_t windowZ) {
+        origin[0] = floorDiv(windowX, int32_t(columnAxis));
+        origin[1] = floorDiv(windowZ, int32_t(columnAxis));
+        loaded[0] = origin[0];
+        loaded[1] = origin[1];
+        held.resize(columns[0]*columns[1]*2);
+        paging.assign(columns[0]*columns[1], false);
+        for (uint32_t bz = 0; bz < columns[1]; bz++) {
+            for (uint32_t bx = 0; bx < columns[0]; bx++) {
+                held[(bz*columns[0]+bx)*2] = target(bx, 0);
+                held[(bz*columns[0]+bx)*2+1] = target(bz, 1);
+            }
+        }
+    }
+
+    // window origin in world voxels, for the world file. only matches the buffer once update() returned true.
+    int32_t windowX() const {
+        return origin[0]*int32_t(columnAxis);
+    }
+
+    int32_t windowZ() const {
+        return origin[1]*int32_t(columnAxis);
+    }
+
+    // world coordinate along axis a (0 to 2) to buffer coordinate, what the shaders are given. stays small however far
+    // the player goes.
+    float bufferCoord(float p, int a) const {
+        return p - float(size[a])*std::floor(p/float(size[a]));
+    }
+
+    // buffer coordinates along x (a 0) or z (a 2) of the columns surely in, with the player at world coordinate p. that
+    // is where the window was and where it is heading overlap, columns past it may still hold what the window left or be
+    // on their way in.
+    std::pair<float, float> bufferRange(float p, int a) const {
+        int c = a/2;
+        float shift = bufferCoord(p, a) - p;
+        float lo = float(std::max(loaded[c], origin[c])*int64_t(columnAxis));
+        float hi = float((std::min(loaded[c], origin[c]) + int64_t(columns[c]))*int64_t(columnAxis));
+        return {lo + shift, hi + shift};
+    }
+
+    // moves the window along with the player at world (posX, posZ), loading at most maxColumns columns that came back
+    // from the thread and sending at most maxColumns out, nearest first. never blocks. returns true when every column
+    // of the window is in.
+    bool update(unsigned int maxColumns, float posX, float posZ) {
+        // recentered only a column past the middle, so walking back and forth over a column edge does not page.
+        int32_t p[2] = {floorDiv(int32_t(std::floor(posX)), int32_t(columnAxis)), floorDiv(int32_t(std::floor(posZ)), int32_t(columnAxis))};
+        for (int a = 0; a < 2; a++) {
+            if (std::abs(p[a] - (origin[a] + int32_t(columns[a]/2))) > 1) origin[a] = p[a] - int32_t(columns[a]/2);
+        }
+
+        // columns the thread is done with go in, in order.
+        for (unsigned int i = 0; i < maxColumns && !jobs.empty() && jobs.front()->state == READY; i++) {
+            load(*jobs.front());
+            jobs.pop_front();
+        }
+
+        // landed readbacks go to the thread, in order, so regions are written before a later column reads them.
+        for (std::unique_ptr<Job>& job : jobs) {
+            if (job->state != COPYING) continue;
+            if (!readback.ready(job->slot)) break;
+            job->state = QUEUED;
+            push(job.get());
+        }
+
+        std::vector<std::pair<int64_t, uint32_t>> pending; // distance to the player squared, buffer column.
+        for (uint32_t bz = 0; bz < columns[1]; bz++) {
+            for (uint32_t bx = 0; bx < columns[0]; bx++) {
+                uint32_t slot = bz*columns[0] + bx;
+                int32_t x = target(bx, 0), z = target(bz, 1);
+                if (paging[slot] || (held[slot*2] == x && held[slot*2+1] == z)) continue;
+                pending.push_back({int64_t(x-p[0])*(x-p[0]) + int64_t(z-p[1])*(z-p[1]), slot});
+            }
+        }
+        std::sort(pending.begin(), pending.end());
+
+        size_t issue = std::min<size_t>(std::min<size_t>(maxColumns, readback.slots - jobs.size()), pending.size());
+        for (size_t i = 0; i < issue; i++) evict(pending[i].second%columns[0], pending[i].second/columns[0]);
+        if (pending.size() > issue || !jobs.empty()) return false;
+        loaded[0] = origin[0];
+        loaded[1] = origin[1];
+        return true;
+    }
+
+    // pages every column still to go, blocking until they are in, for before the window is saved.
+    void drain(float posX, float posZ) {
+        while (!update(readback.slots, posX, posZ)) wait();
+    }
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef WORLDPATCH_H
+#define WORLDPATCH_H
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <classes/WorldFile.h>
+
+// .punp world patches, the bricks that differ between a base world and an edited copy of it.
+// worlds are identified by a content hash of their voxels (journal included), so a patch made against one save
+// applies to any file with the same contents, whatever its format version.
+//   header  : Header struct below.
+//   records : count {uint32 brick, uint16 size, run length coded brick} records, sorted by brick, as in the journal.
+class WorldPatch
+{
+public:
+    static const uint32_t MAGIC = 0x504E5550; // "PUNP" in little endian.
+    static const uint32_t VERSION = 1;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t axisSize; // x size, the content hashes tell worlds of other sizes apart.
+        uint32_t passRes;
+        uint64_t baseHash; // content hash of the world the patch applies to.
+        uint64_t resultHash; // content hash after applying it.
+        uint32_t count;
+        uint32_t reserved;
+    };
+
+    static const uint64_t HASH_SEED = 0xCBF29CE484222325ull;
+
+    // running content hash, fed voxel ranges in order starting from HASH_SEED. sizes must be multiples of 8.
+    static uint64_t hash(uint64_t h, const uint8_t* voxels, uint64_t size) {
+        for (uint64_t i = 0; i < size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, voxels+i, 8);
+            h = (h ^ word) * 0x100000001B3ull;
+            h ^= h >> 29;
+        }
+        return h;
+    }
+
+    // writes the bricks of edited that differ from base, both opened, to a patch at path.
+    static bool create(WorldFile& base, WorldFile& edited, const std::string& path, uint64_t chunkSize) {
+        Header header = {MAGIC, VERSION, base.size[0], base.passRes, HASH_SEED, HASH_SEED, 0, 0};
+        std::string tmpPath = path + ".tmp";
+        std::ofstream outFile(tmpPath, std::ios::binary | std::ios::trunc);
+        outFile.write(reinterpret_cast<const char*>(&header), sizeof(Header)); // filled in at the end.
+
+        std::vector<uint8_t> baseChunk(std::min(chunkSize, base.rawSize()));
+        std::vector<uint8_t> editedChunk(baseChunk.size());
+        std::vector<uint8_t> scratch(2*base.brickBytes);
+        for (uint64_t offset = 0; offset < base.rawSize(); offset += baseChunk.size()) {
+            uint64_t size = std::min<uint64_t>(baseChunk.size(), base.rawSize()-offset);
+            if (!base.readRange(offset, size, baseChunk.data()) || !edited.readRange(offset, size, editedChunk.data())) {
+                std::cout<<"Failed to decode voxels "<<offset<<" to "<<offset+size<<std::endl;
+                outFile.close();
+                std::error_code ec;
+                std::filesystem::remove(tmpPath, ec);
+                return false;
+            }
+            header.baseHash = hash(header.baseHash, baseChunk.data(), size);
+            header.resultHash = hash(header.resultHash, editedChunk.data(), size);
+            for (uint64_t b = 0; b < size; b += base.brickBytes) {
+                if (std::memcmp(baseChunk.data()+b, editedChunk.data()+b, base.brickBytes) == 0) continue;
+                uint32_t brick = uint32_t((offset+b)/base.brickBytes);
+                uint16_t length = uint16_t(base.encodeBrick(editedChunk.data()+b, scratch.data()));
+                outFile.write(reinterpret_cast<const char*>(&brick), sizeof(uint32_t));
+                outFile.write(reinterpret_cast<const char*>(&length), sizeof(uint16_t));
+                outFile.write(reinterpret_cast<const char*>(scratch.data()), length);
+                header.count++;
+            }
+        }
+        outFile.seekp(0);
+        outFile.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        outFile.close();
+
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        std::filesystem::rename(tmpPath, path, ec);
+        if (!outFile || ec) return false;
+        std::cout<<"Patch of "<<header.count<<" bricks ("<<std::filesystem::file_size(path)/1024<<" KiB)"<<std::endl;
+        return true;
+    }
+
+    // writes base, opened, with the patch at path applied to out. fails if base is not the world the patch was made from.
+    static bool apply(WorldFile& base, const std::string& path, WorldFile& out, uint64_t chunkSize) {
+        std::ifstream inFile(path, std::ios::binary);
+        Header header = {};
+        inFile.read(reinterpret_cast<char*>(&header), sizeof(Header));
+        if (!inFile || header.magic != MAGIC) {
+            std::cout<<"Not a world patch: "<<path<<std::endl;
+            return false;
+        }
+        if (header.axisSize != base.size[0] || header.passRes != base.passRes) {
+            std::cout<<"Patch was made for axis size "<<header.axisSize<<" and pass resolution "<<header.passRes<<std::endl;
+            return false;
+        }
+
+        // records come sorted, so they are read along with the chunks they land in.
+        uint32_t read = 0;
+        uint32_t brick = 0;
+        uint16_t length = 0;
+        std::vector<uint8_t> record(2*base.brickBytes);
+        auto next = [&]() {
+            if (read == header.count) return false;
+            inFile.read(reinterpret_cast<char*>(&brick), sizeof(uint32_t));
+            inFile.read(reinterpret_cast<char*>(&length), sizeof(uint16_t));
+            if (length > record.size()) return false;
+            inFile.read(reinterpret_cast<char*>(record.data()), length);
+            read++;
+            return bool(inFile);
+        };
+        bool pending = next();
+
+        uint64_t baseHash = HASH_SEED;
+        uint64_t resultHash = HASH_SEED;
+        std::vector<uint8_t> chunk(std::min(chunkSize, base.rawSize()));
+        if (!out.beginWrite()) return false;
+        for (uint64_t offset = 0; offset < base.rawSize(); offset += chunk.size()) {
+            uint64_t size = std::min<uint64_t>(chunk.size(), base.rawSize()-offset);
+            if (!base.readRange(offset, size, chunk.data())) {
+                std::cout<<"Failed to decode voxels "<<offset<<" to "<<offset+size<<std::endl;
+                out.abortWrite();
+                return false;
+            }
+            baseHash = hash(baseHash, chunk.data(), size);
+            uint64_t last = (offset+size)/base.brickBytes;
+            while (pending && brick < last) {
+                uint64_t at = uint64_t(brick)*base.brickBytes;
+                if (at < offset || !base.decodeBrick(record.data(), length, chunk.data() + (at-offset))) break;
+                pending = next();
+            }
+            resultHash = hash(resultHash, chunk.data(), size);
+            out.writeRange(offset, size, chunk.data());
+        }
+
+        if (baseHash != header.baseHash) {
+            std::cout<<"Patch does not apply, "<<base.path<<" is not the world it was made from"<<std::endl;
+            out.abortWrite();
+            return false;
+        }
+        if (read != header.count || pending || resultHash != header.resultHash) {
+            std::cout<<"Damaged patch: "<<path<<std::endl;
+            out.abortWrite();
+            return false;
+        }
+        base.close(); // out may replace it.
+        return out.endWrite();
+    }
+};
+
+#endif
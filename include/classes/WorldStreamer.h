@@ -0,0 +1,167 @@
+#ifndef WORLDSTREAMER_H
+#define WORLDSTREAMER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <classes/BrickPool.h>
+#include <classes/Morton.h>
+#include <classes/StagingRing.h>
+#include <classes/WorldFile.h>
+
+// uploads an opened world file over several frames, nearest regions to the player first.
+// the brick pool starts cleared and the occupancy mask all empty, so everything not streamed in yet reads as air
+// and the passes render what is already there. a region is a cube of regionAxis^3 voxels, which in morton order
+// is one contiguous range of bricks and of the mask. only the regions non-empty bricks are uploaded, as
+// {brick index, brick uints} records the brick pool scatters into freshly allocated slots.
+class WorldStreamer
+{
+private:
+    WorldFile& worldFile;
+    StagingRing ring;
+    BrickPool& bricks;
+    GLuint maskBuffer;
+    uint32_t regionAxis;
+    uint64_t regionBytes;
+    uint32_t regionMaskWords;
+    uint64_t recordBytes; // brick index then the brick.
+    std::vector<uint8_t> decoded; // decoded regions of the slot being filled.
+    std::vector<uint32_t> regionRecords;
+    std::vector<uint32_t> order; // region indices, nearest first.
+    std::vector<uint32_t> storedMask; // mask from the world file, when it has a valid one.
+    size_t nextRegion = 0;
+
+public:
+    bool active = false;
+    bool failed = false;
+
+    WorldStreamer(WorldFile& file, BrickPool& pool, GLuint mask, size_t budget, unsigned int slots, unsigned int axis = 64)
+        : worldFile(file), ring(budget, slots), bricks(pool) {
+        maskBuffer = mask;
+        regionAxis = axis;
+        regionBytes = uint64_t(regionAxis)*regionAxis*regionAxis;
+        regionMaskWords = uint32_t(regionBytes/worldFile.brickBytes/32);
+        recordBytes = sizeof(uint32_t) + worldFile.brickBytes;
+    }
+
+    // starts streaming the opened world file, around the given position.
+    void start(float posX, float posY, float posZ) {
+        // nothing is loaded yet, so everything is air and every brick empty.
+        GLuint empty = 0xFFFFFFFFu;
+        bricks.reset();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, maskBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &empty);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        storedMask.resize(worldFile.maskWords());
+        if (!worldFile.readMask(storedMask.data())) storedMask.clear();
+
+        // regions are whole cubes of the world layout, so their index decodes into region coordinates.
+        uint32_t regionCount = uint32_t(worldFile.rawSize()/regionBytes);
+        WorldLayout regions = worldFile.layout().scaled(regionAxis);
+        std::vector<float> distance(regionCount);
+        order.resize(regionCount);
+        for (uint32_t r = 0; r < regionCount; r++) {
+            uint32_t x, y, z;
+            regions.decode(r, x, y, z);
+            float dx = (float(x)+0.5f)*regionAxis - posX;
+            float dy = (float(y)+0.5f)*regionAxis - posY;
+            float dz = (float(z)+0.5f)*regionAxis - posZ;
+            distance[r] = dx*dx + dy*dy + dz*dz;
+            order[r] = r;
+        }
+        std::sort(order.begin(), order.end(), [&distance](uint32_t a, uint32_t b) { return distance[a] < distance[b]; });
+
+        nextRegion = 0;
+        failed = false;
+        active = true;
+    }
+
+    // uploads the next slot worth of regions. returns true once every region is in.
+    bool update() {
+        if (!active) return true;
+
+        // slots are sized for regions that are entirely solid, the records of a region plus its mask words.
+        uint64_t regionBricks = regionBytes/worldFile.brickBytes;
+        uint64_t maskBytes = uint64_t(regionMaskWords)*sizeof(uint32_t);
+        uint64_t stride = regionBricks*recordBytes + maskBytes;
+        uint8_t* slot = ring.acquire();
+        size_t count = std::min<size_t>(std::min(ring.slotSize, bricks.stageSize)/stride, order.size()-nextRegion);
+        decoded.resize(count*regionBytes);
+        regionRecords.assign(count, 0);
+
+        // regions are independent, so they are decoded on the world files pool.
+        std::atomic<bool> valid{true};
+        worldFile.pool.run(count, [&](size_t i) {
+            uint32_t r = order[nextRegion+i];
+            uint8_t* voxels = decoded.data() + i*regionBytes;
+            uint8_t* records = slot + i*stride;
+            uint32_t* mask = reinterpret_cast<uint32_t*>(records + regionBricks*recordBytes);
+            if (!worldFile.readRange(r*regionBytes, regionBytes, voxels)) {
+                valid = false;
+                return;
+            }
+
+            // regions mask words, from the file or worked out from the voxels.
+            uint64_t firstBrick = r*regionBytes/worldFile.brickBytes;
+            if (!storedMask.empty()) {
+                std::memcpy(mask, &storedMask[firstBrick/32], maskBytes);
+            } else {
+                for (uint32_t w = 0; w < regionMaskWords; w++) {
+                    uint32_t bits = 0;
+                    for (uint32_t b = 0; b < 32; b++) {
+                        if (worldFile.brickEmpty(voxels + uint64_t(w*32+b)*worldFile.brickBytes)) bits |= 1u << b;
+                    }
+                    mask[w] = bits;
+                }
+            }
+
+            // air bricks stay on the shared air slot, everything else becomes a record.
+            uint32_t n = 0;
+            for (uint64_t b = 0; b < regionBricks; b++) {
+                const uint8_t* brick = voxels + b*worldFile.brickBytes;
+                if (worldFile.brickEmpty(brick)) continue;
+                uint32_t cm = uint32_t(firstBrick + b);
+                std::memcpy(records + n*recordBytes, &cm, sizeof(uint32_t));
+                std::memcpy(records + n*recordBytes + sizeof(uint32_t), brick, worldFile.brickBytes);
+                n++;
+            }
+            regionRecords[i] = n;
+        });
+        if (!valid) failed = true;
+
+        // records of every region are packed together into the stage buffer, so one scatter places them all.
+        uint32_t staged = 0;
+        for (size_t i = 0; i < count && !failed; i++) {
+            uint32_t r = order[nextRegion+i];
+            uint64_t firstBrick = r*regionBricks;
+            if (regionRecords[i] != 0) ring.copy(bricks.stage, staged*recordBytes, regionRecords[i]*recordBytes, i*stride);
+            ring.copy(maskBuffer, firstBrick/32*sizeof(uint32_t), maskBytes, i*stride + regionBricks*recordBytes);
+            staged += regionRecords[i];
+        }
+        ring.release();
+        if (!failed) {
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            bricks.scatter(staged);
+        }
+        nextRegion += count;
+
+        if (nextRegion < order.size() && !failed) return false;
+        ring.finish();
+        storedMask = std::vector<uint32_t>();
+        decoded = std::vector<uint8_t>();
+        active = false;
+        return true;
+    }
+
+    float progress() const {
+        return order.empty() ? 1.0f : float(nextRegion)/float(order.size());
+    }
+};
+
+#endif
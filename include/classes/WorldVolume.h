@@ -0,0 +1,318 @@
+#ifndef WORLDVOLUME_H
+#define WORLDVOLUME_H
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define WORLDVOLUME_SSE2
+#endif
+
+#include <classes/Morton.h>
+#include <classes/WorldFile.h>
+
+// the voxel buffer on the host, for answering questions about the world without reading ssbo0 back. stored the way
+// BrickPool stores it on the GPU: a brick map entry per brick (indexed by cm, 0 for air, UNIFORM|material for a
+// brick of one material, otherwise a slot) and 16 uints per slot, voxels in world layout order, four to a uint.
+// coordinates are buffer coordinates as the shaders see them, x and z wrap around the buffer like there.
+// WorldMirror keeps it in sync with the GPU, set() only changes the host copy. bricks the mirror hands in tagged JOURNAL
+// were edited since the GPU last handed them in, they are flagged as changed until the next save takes them.
+class WorldVolume
+{
+public:
+    static const uint32_t UNIFORM = 0x80000000u;
+    static const uint32_t JOURNAL = 0x40000000u; // record tag, the brick was edited.
+    static const uint32_t END = 0xFFFFFFFFu; // ends a run of records early.
+    static const uint32_t BRICK_UINTS = 16;
+
+    struct Hit {
+        int32_t voxel[3];
+        int32_t normal[3]; // face the ray came in through, 0 when it started inside.
+        uint8_t material;
+        float distance;
+    };
+
+    WorldLayout layout;
+    uint32_t size[3];
+    uint64_t numBricks;
+
+    WorldVolume(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ) : layout(sizeX, sizeY, sizeZ) {
+        size[0] = sizeX;
+        size[1] = sizeY;
+        size[2] = sizeZ;
+        numBricks = layout.cells()/64;
+        clear();
+    }
+
+    // makes the whole world air.
+    void clear() {
+        map.assign(numBricks, 0);
+        pool.assign(BRICK_UINTS, 0); // slot 0 is the air brick.
+        freeSlots.clear();
+        changed.assign((numBricks+31)/32, 0);
+    }
+
+    uint8_t get(uint32_t x, uint32_t y, uint32_t z) const {
+        uint32_t i = layout.index(x, y, z);
+        return voxel(map[i >> 6], i & 63u);
+    }
+
+    void set(uint32_t x, uint32_t y, uint32_t z, uint8_t value) {
+        uint32_t i = layout.index(x, y, z);
+        uint32_t cm = i >> 6;
+        uint32_t entry = map[cm];
+        if (entry == 0 || (entry & UNIFORM) != 0) {
+            if (voxel(entry, i & 63u) == value) return;
+            uint32_t words[BRICK_UINTS];
+            std::fill(words, words+BRICK_UINTS, (entry & 0xFFu)*0x01010101u);
+            entry = map[cm] = allocSlot();
+            std::memcpy(&pool[entry*BRICK_UINTS], words, sizeof(words));
+        }
+        uint32_t& word = pool[entry*BRICK_UINTS + ((i & 63u) >> 2)];
+        uint32_t shift = (i & 3u)*8;
+        word = (word & ~(0xFFu << shift)) | (uint32_t(value) << shift);
+    }
+
+    // replaces brick cm, bricks of one material give their slot back.
+    void setBrick(uint32_t cm, const uint32_t* words) {
+        if (uniformBrick(words)) {
+            setUniform(cm, uint8_t(words[0]));
+            return;
+        }
+        uint32_t entry = map[cm];
+        if (entry == 0 || (entry & UNIFORM) != 0) entry = map[cm] = allocSlot();
+        std::memcpy(&pool[entry*BRICK_UINTS], words, BRICK_UINTS*sizeof(uint32_t));
+    }
+
+    void setUniform(uint32_t cm, uint8_t material) {
+        uint32_t entry = map[cm];
+        if (entry != 0 && (entry & UNIFORM) == 0) freeSlots.push_back(entry);
+        map[cm] = material == 0 ? 0 : UNIFORM | material;
+    }
+
+    // applies records as the mirror gather writes them, brick index and 16 uints, or brick index|UNIFORM and a
+    // material, either index also tagged JOURNAL for edited bricks. returns the bricks applied.
+    uint64_t apply(const uint32_t* records, uint64_t words) {
+        uint64_t applied = 0;
+        uint64_t r = 0;
+        while (r < words && records[r] != END) {
+            uint32_t cm = records[r] & ~(UNIFORM | JOURNAL);
+            uint64_t length = (records[r] & UNIFORM) != 0 ? 2 : 1+BRICK_UINTS;
+            if (r+length > words || cm >= numBricks) break;
+            if ((records[r] & JOURNAL) != 0) changed[cm >> 5] |= 1u << (cm & 31u);
+            if (length == 2) setUniform(cm, uint8_t(records[r+1]));
+            else setBrick(cm, records+r+1);
+            r += length;
+            applied++;
+        }
+        return applied;
+    }
+
+    bool brickEmpty(uint32_t cm) const {
+        return map[cm] == 0;
+    }
+
+    // the uints of brick cm, uniform and air bricks are written out into scratch.
+    const uint32_t* brick(uint32_t cm, uint32_t scratch[BRICK_UINTS]) const {
+        uint32_t entry = map[cm];
+        if (entry != 0 && (entry & UNIFORM) == 0) return &pool[entry*BRICK_UINTS];
+        std::fill(scratch, scratch+BRICK_UINTS, (entry & 0xFFu)*0x01010101u);
+        return scratch;
+    }
+
+    // copies count bricks from first on out as the world file stores them, 64 bytes each.
+    void copyBricks(uint64_t first, uint64_t count, uint32_t* out) const {
+        uint32_t scratch[BRICK_UINTS];
+        for (uint64_t b = 0; b < count; b++) std::memcpy(out + b*BRICK_UINTS, brick(uint32_t(first+b), scratch), 64);
+    }
+
+    // forgets which bricks changed, when a full save takes them all.
+    void clearChanged() {
+        std::fill(changed.begin(), changed.end(), 0);
+    }
+
+    // appends the changed bricks to the world journal, batchBricks to a batch, and clears their flags. returns the
+    // bricks journaled, or -1 when writing failed, the bricks of the failed batch and after stay flagged then.
+    int64_t journal(WorldFile& file, uint32_t batchBricks) {
+        std::vector<uint32_t> records;
+        std::vector<uint32_t> batch; // bricks in records.
+        int64_t total = 0;
+        for (uint64_t cm = 0; cm <= numBricks; cm++) {
+            if (batch.size() == batchBricks || (cm == numBricks && !batch.empty())) {
+                if (!file.appendJournal(records.data(), uint32_t(batch.size()))) return -1;
+                for (uint32_t b : batch) changed[b >> 5] &= ~(1u << (b & 31u));
+                total += int64_t(batch.size());
+                records.clear();
+                batch.clear();
+            }
+            if (cm == numBricks) break;
+            if (changed[cm >> 5] == 0) { // 32 unchanged bricks.
+                cm |= 31;
+                continue;
+            }
+            if ((changed[cm >> 5] & (1u << (cm & 31u))) == 0) continue;
+            batch.push_back(uint32_t(cm));
+            records.push_back(uint32_t(cm));
+            records.resize(records.size() + BRICK_UINTS);
+            copyBricks(cm, 1, &records[records.size()-BRICK_UINTS]);
+        }
+        return total;
+    }
+
+    // calls fn(cm, voxels) for every brick that is not air, voxels being its 64 bytes.
+    template <typename Fn>
+    void forEachBrick(Fn fn) const {
+        uint32_t scratch[BRICK_UINTS];
+        for (uint64_t cm = 0; cm < numBricks; cm++) {
+            if (map[cm] == 0) continue;
+            fn(uint32_t(cm), reinterpret_cast<const uint8_t*>(brick(uint32_t(cm), scratch)));
+        }
+    }
+
+    // voxels of a material in the whole world, air included.
+    uint64_t count(uint8_t material) const {
+        uint64_t total = 0;
+        for (uint64_t cm = 0; cm < numBricks; cm++) {
+            uint32_t entry = map[cm];
+            if (entry == 0 || (entry & UNIFORM) != 0) total += (entry & 0xFFu) == material ? 64 : 0;
+            else total += countBrick(&pool[entry*BRICK_UINTS], material);
+        }
+        return total;
+    }
+
+    // first solid voxel along the ray within maxDist, air bricks are crossed in one step. rays leaving the world
+    // through the top or bottom miss.
+    bool raycast(const float origin[3], const float dir[3], float maxDist, Hit& hit) const {
+        float length = std::sqrt(dir[0]*dir[0] + dir[1]*dir[1] + dir[2]*dir[2]);
+        if (length == 0.0f) return false;
+        float rd[3], dr[3], tMax[3];
+        int32_t vp[3], stride[3];
+        for (int a = 0; a < 3; a++) {
+            rd[a] = dir[a]/length;
+            dr[a] = 1.0f/std::max(std::abs(rd[a]), 1e-6f);
+            stride[a] = rd[a] > 0.0f ? 1 : -1;
+            vp[a] = int32_t(std::floor(origin[a]));
+        }
+        resetTMax(origin, rd, dr, vp, tMax);
+
+        int axis = -1;
+        float t = 0.0f;
+        while (t <= maxDist) {
+            if (vp[1] < 0 || vp[1] >= int32_t(size[1])) {
+                if ((vp[1] < 0) == (rd[1] <= 0.0f)) return false; // heading further out.
+            } else {
+                uint32_t i = layout.index(uint32_t(vp[0]), uint32_t(vp[1]), uint32_t(vp[2])); // wraps negatives too.
+                uint32_t entry = map[i >> 6];
+                if (entry == 0) {
+                    // leave the air brick, landing in the one after it.
+                    int32_t boxMin[3] = {vp[0] & ~3, vp[1] & ~3, vp[2] & ~3};
+                    float tExit[3];
+                    for (int a = 0; a < 3; a++) tExit[a] = std::abs(float(boxMin[a] + (rd[a] > 0.0f ? 4 : 0)) - origin[a])*dr[a];
+                    axis = tExit[0] <= tExit[1] && tExit[0] <= tExit[2] ? 0 : (tExit[1] <= tExit[2] ? 1 : 2);
+                    t = tExit[axis];
+                    for (int a = 0; a < 3; a++) vp[a] = std::clamp(int32_t(std::floor(origin[a] + rd[a]*t)), boxMin[a], boxMin[a]+3);
+                    vp[axis] = stride[axis] > 0 ? boxMin[axis]+4 : boxMin[axis]-1;
+                    resetTMax(origin, rd, dr, vp, tMax);
+                    continue;
+                }
+                uint8_t material = voxel(entry, i & 63u);
+                if (material != 0) {
+                    for (int a = 0; a < 3; a++) {
+                        hit.voxel[a] = vp[a];
+                        hit.normal[a] = a == axis ? -stride[a] : 0;
+                    }
+                    hit.material = material;
+                    hit.distance = t;
+                    return true;
+                }
+            }
+            axis = tMax[0] <= tMax[1] && tMax[0] <= tMax[2] ? 0 : (tMax[1] <= tMax[2] ? 1 : 2);
+            t = tMax[axis];
+            vp[axis] += stride[axis];
+            tMax[axis] += dr[axis];
+        }
+        return false;
+    }
+
+    // writes the world to a world file, chunkBytes of voxels at a time (a multiple of the brick size).
+    // player and window have to be set on the file first.
+    bool save(WorldFile& file, uint64_t chunkBytes) {
+        if (file.rawSize() != numBricks*64 || !file.beginWrite()) return false;
+        std::vector<uint32_t> chunk(chunkBytes/4);
+        uint64_t chunkBricks = chunkBytes/64;
+        for (uint64_t first = 0; first < numBricks; first += chunkBricks) {
+            uint64_t bricks = std::min(chunkBricks, numBricks-first);
+            copyBricks(first, bricks, chunk.data());
+            if (!file.writeRange(first*64, bricks*64, reinterpret_cast<const uint8_t*>(chunk.data()))) {
+                file.abortWrite();
+                return false;
+            }
+        }
+        if (!file.endWrite()) return false;
+        clearChanged();
+        return true;
+    }
+
+private:
+    std::vector<uint32_t> map;
+    std::vector<uint32_t> pool;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint32_t> changed; // bit per brick edited since the last save.
+
+    uint32_t allocSlot() {
+        if (!freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        pool.resize(pool.size() + BRICK_UINTS);
+        return uint32_t(pool.size()/BRICK_UINTS - 1);
+    }
+
+    uint8_t voxel(uint32_t entry, uint32_t v) const {
+        if (entry == 0 || (entry & UNIFORM) != 0) return uint8_t(entry);
+        return uint8_t(pool[entry*BRICK_UINTS + (v >> 2)] >> ((v & 3u)*8));
+    }
+
+    static void resetTMax(const float origin[3], const float rd[3], const float dr[3], const int32_t vp[3], float tMax[3]) {
+        for (int a = 0; a < 3; a++) tMax[a] = (rd[a] > 0.0f ? float(vp[a]) + 1.0f - origin[a] : origin[a] - float(vp[a]))*dr[a];
+    }
+
+    // all 64 voxels the same, 16 byte compares at a time.
+    static bool uniformBrick(const uint32_t* words) {
+        uint32_t fill = (words[0] & 0xFFu)*0x01010101u;
+#ifdef WORLDVOLUME_SSE2
+        __m128i f = _mm_set1_epi32(int(fill));
+        __m128i same = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(words)), f);
+        for (int i = 1; i < 4; i++) same = _mm_and_si128(same, _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(words+i*4)), f));
+        return _mm_movemask_epi8(same) == 0xFFFF;
+#else
+        for (uint32_t i = 0; i < BRICK_UINTS; i++) {
+            if (words[i] != fill) return false;
+        }
+        return true;
+#endif
+    }
+
+    static uint32_t countBrick(const uint32_t* words, uint8_t material) {
+#ifdef WORLDVOLUME_SSE2
+        __m128i m = _mm_set1_epi8(char(material));
+        uint32_t n = 0;
+        for (int i = 0; i < 4; i++) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words+i*4));
+            n += uint32_t(std::bitset<16>(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, m)))).count());
+        }
+        return n;
+#else
+        const uint8_t* voxels = reinterpret_cast<const uint8_t*>(words);
+        return uint32_t(std::count(voxels, voxels+64, material));
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,153 @@
+// brick map and compact brick declarations, shared by every shader touching the sparse storage. the Shader class
+// pastes this in where a shader has #include "4.3.bricks.glsl", so the layout and the decoding live in one place.
+
+// sparse storage, see BrickPool.h.
+layout(std430, binding = 6) buffer BrickMap {
+    uint brickMap[]; // pool slot of every brick, 0 for the shared air brick, UNIFORM|material for a brick of one material,
+                     // COMPACT|compact slot for a brick of up to four.
+};
+
+const uint UNIFORM = 0x80000000u; // tags brick map entries of uniform bricks, which have no slot.
+const uint COMPACT = 0x40000000u; // tags brick map entries of compact bricks, which have a compact slot instead.
+
+// bricks of two to four materials, at two bits a voxel. see BrickPool.h.
+layout(std430, binding = 18) buffer CompactBricks {
+    uint compactFree; // slots on the free stack.
+    uint compactNext; // first slot never handed out.
+    uint compactSlots;
+    uint compactReleased; // slots given up since the last recycle.
+    uint compactFailures;
+    uint compactData[]; // free slot stack (compactSlots), released slots (compactSlots), then the records.
+};
+
+// records of COMPACT_UINTS uints: 64 two bit palette indices (morton order within the brick), the palette (a material
+// byte per index), then the indices of the 2^3 mip cells.
+const uint COMPACT_UINTS = 6u;
+
+uint compactRecord(uint entry) {
+    return 2u*compactSlots + (entry & ~COMPACT)*COMPACT_UINTS;
+}
+
+// voxel v (morton order within the brick) of a compact brick.
+uint compactVoxel(uint entry, uint v) {
+    uint r = compactRecord(entry);
+    uint index = (compactData[r + (v >> 4u)] >> ((v & 15u)*2u)) & 3u;
+    return (compactData[r+4u] >> (index*8u)) & 0xFFu;
+}
+
+// uint j of a compact brick, as it would be in the pool.
+uint compactWord(uint entry, uint j) {
+    uint r = compactRecord(entry);
+    uint indices = compactData[r + (j >> 2u)] >> ((j & 3u)*8u);
+    uint palette = compactData[r+4u];
+    uint word = 0u;
+    for (uint k = 0u; k < 4u; k++) word |= ((palette >> (((indices >> (k*2u)) & 3u)*8u)) & 0xFFu) << (k*8u);
+    return word;
+}
+
+// solid bits of a compact brick. each uint of indices gives 16 bits, the voxels whose index is not an air one.
+uvec2 compactBits(uint entry) {
+    uint r = compactRecord(entry);
+    uint palette = compactData[r+4u];
+    uvec2 bits = uvec2(0u);
+    for (uint w = 0u; w < 4u; w++) {
+        uint lo = compactData[r+w];
+        uint hi = lo >> 1u;
+        uint air = 0u;
+        for (uint index = 0u; index < 4u; index++) {
+            if (((palette >> (index*8u)) & 0xFFu) != 0u) continue;
+            air |= ((index & 1u) != 0u ? lo : ~lo) & ((index & 2u) != 0u ? hi : ~hi);
+        }
+        // the even bits (one per voxel) squeezed into 16.
+        uint solid = ~air & 0x55555555u;
+        solid = (solid | (solid >> 1)) & 0x33333333u;
+        solid = (solid | (solid >> 2)) & 0x0F0F0F0Fu;
+        solid = (solid | (solid >> 4)) & 0x00FF00FFu;
+        solid = (solid | (solid >> 8)) & 0x0000FFFFu;
+        bits[w >> 1u] |= solid << ((w & 1u)*16u);
+    }
+    return bits;
+}
+
+// material of a cell from its eight children (bytes, morton order), air unless at least half of them are solid, then
+// the most common solid one. the mip pass and compact bricks both use it, so they agree on the cells.
+uint majority(uvec2 children) {
+    uint best = 0u;
+    uint bestCount = 0u;
+    uint solid = 0u;
+    for (uint i = 0u; i < 8u; i++) {
+        uint mat = (children[i >> 2u] >> ((i & 3u)*8u)) & 0xFFu;
+        if (mat == 0u) continue;
+        solid++;
+        uint count = 0u;
+        for (uint j = 0u; j < 8u; j++) {
+            if (((children[j >> 2u] >> ((j & 3u)*8u)) & 0xFFu) == mat) count++;
+        }
+        if (count > bestCount) {
+            best = mat;
+            bestCount = count;
+        }
+    }
+    return solid >= 4u ? best : 0u;
+}
+
+// index of mat among the first n materials of a palette, n when it is not there.
+uint paletteIndex(uint palette, uint n, uint mat) {
+    for (uint i = 0u; i < n; i++) {
+        if (((palette >> (i*8u)) & 0xFFu) == mat) return i;
+    }
+    return n;
+}
+
+// palette of a brick given its uints, a material byte per index, air included. materials is how many, given up on at 5.
+uint brickPalette(uint words[16], out uint materials) {
+    uint palette = 0u;
+    materials = 0u;
+    for (uint j = 0u; j < 16u; j++) {
+        for (uint k = 0u; k < 4u; k++) {
+            uint mat = (words[j] >> (k*8u)) & 0xFFu;
+            if (paletteIndex(palette, materials, mat) < materials) continue;
+            if (materials == 4u) {
+                materials = 5u;
+                return palette;
+            }
+            palette |= mat << (materials*8u);
+            materials++;
+        }
+    }
+    return palette;
+}
+
+// puts a brick of two to four materials (its uints and brickPalette()) in a free compact slot, and returns its brick map
+// entry. 0 when the compact pool is full, the brick then has to go in the brick pool.
+uint compactStore(uint words[16], uint palette, uint materials) {
+    uint c;
+    uint n = atomicAdd(compactFree, 0xFFFFFFFFu); // pop a free compact slot.
+    if (n-1u < compactSlots) {
+        c = compactData[n-1u];
+    } else {
+        atomicAdd(compactFree, 1u);
+        c = atomicAdd(compactNext, 1u);
+        if (c >= compactSlots) {
+            atomicAdd(compactFailures, 1u);
+            return 0u;
+        }
+    }
+
+    uint r = 2u*compactSlots + c*COMPACT_UINTS;
+    for (uint w = 0u; w < 4u; w++) {
+        uint indices = 0u;
+        for (uint v = 0u; v < 16u; v++) {
+            uint mat = (words[w*4u + (v >> 2u)] >> ((v & 3u)*8u)) & 0xFFu;
+            indices |= paletteIndex(palette, materials, mat) << (v*2u);
+        }
+        compactData[r+w] = indices;
+    }
+    compactData[r+4u] = palette;
+    uint cells = 0u;
+    for (uint k = 0u; k < 8u; k++) {
+        cells |= paletteIndex(palette, materials, majority(uvec2(words[k*2u], words[k*2u+1u]))) << (k*2u);
+    }
+    compactData[r+5u] = cells;
+    return COMPACT | c;
+}
@@ -4,6 +4,20 @@
 #include <classes/GLshader.h>
 #include <classes/PlayerController.h>
 #include <classes/StartupTUI.h>
+#include <classes/WorldFile.h>
+#include <classes/StagingRing.h>
+#include <classes/BrickPool.h>
+#include <classes/DistanceField.h>
+#include <classes/AutoSaver.h>
+#include <classes/WorldStreamer.h>
+#include <classes/WorldPager.h>
+#include <classes/EditHistory.h>
+#include <classes/MaterialTable.h>
+#include <classes/MaterialMips.h>
+#include <classes/WorldMirror.h>
+#include <classes/BrickAtlas.h>
+#include <classes/GpuTimer.h>
+#include <classes/CameraPath.h>
 
 #include <iostream>
 #include <array>
@@ -11,6 +25,8 @@
 #include <vector>
 #include <cmath>
 #include <random>
+#include <algorithm>
+#include <memory>
 
 #include <filesystem>
 namespace fs = std::filesystem;
@@ -21,6 +37,10 @@ void processInput(GLFWwindow *window);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processPlayer(PlayerController Player, Shader lowRes, Shader highRes);
 void updateSettings();
+bool saveIncremental(WorldFile& worldFile, WorldMirror& mirror, WorldVolume& volume);
+void buildMaskPyramid(Shader& pyramidShader);
+void setWindow(Shader& shader, std::pair<float, float> x, std::pair<float, float> z);
+void dispatchEdit(Shader& editShader, EditHistory& history, int size);
 
 // pointers
 Shader* lowResPtr;
@@ -31,16 +51,29 @@ GLuint coarseFBO; // FBO for low resolution
 GLuint coarseTex; // result of low res pass
 
 GLuint prePassTex; // prepass texture
+GLuint reprojTex; // last prepass moved into the current view
+bool prePassStale = true; // the prepass texture holds no previous frame, after a resize.
 GLuint screenTex; // screen texture
 
 // SETTINGS
 
 // world
-const unsigned int AXIS_SIZE = 1024;
+// world size in voxels, compiled into the shaders. powers of two, the height at least 256 (the coarsest mask cell) and
+// at most the width and depth, at most 4096 across (distance field lines) and at most 2^32 voxels. terrain reaches up to
+// around y=460 and is cut off by lower worlds.
+const unsigned int WORLD_X = 1024;
+const unsigned int WORLD_Y = 1024;
+const unsigned int WORLD_Z = 1024;
 const unsigned int PASS_RES = 4; // occupancy mask width, and step size of low res pass.
-const unsigned int NUM_VOXELS = AXIS_SIZE * AXIS_SIZE * AXIS_SIZE;
-const unsigned int NUM_VUINTS = (NUM_VOXELS + 3) / 4; // ceil division, amount of uints total.
-const unsigned int NUM_GUINTS = (NUM_VUINTS)/(PASS_RES*PASS_RES*PASS_RES); // uints per group for low res pass.
+const uint64_t NUM_VOXELS = uint64_t(WORLD_X) * WORLD_Y * WORLD_Z;
+const unsigned int NUM_BRICKS = unsigned(NUM_VOXELS/(PASS_RES*PASS_RES*PASS_RES)); // PASS_RES^3 bricks, one occupancy (and dirty) bit each.
+static_assert((WORLD_X & (WORLD_X-1)) == 0 && (WORLD_Y & (WORLD_Y-1)) == 0 && (WORLD_Z & (WORLD_Z-1)) == 0, "world sizes must be powers of two");
+static_assert(WORLD_Y >= 256 && WORLD_Y <= WORLD_X && WORLD_Y <= WORLD_Z && WORLD_X <= 4096 && WORLD_Z <= 4096 && NUM_VOXELS <= (uint64_t(1) << 32), "unsupported world size");
+const unsigned int BRICK_UINTS = (PASS_RES*PASS_RES*PASS_RES)/4;
+uint32_t POOL_BRICKS = NUM_BRICKS/16; // brick slots on the GPU (64 MiB), only bricks of five or more materials take one. writes past it are dropped.
+uint32_t COMPACT_BRICKS = NUM_BRICKS/16; // bricks of two to four materials kept at 2 bits a voxel (32 MiB), 0 turns it off.
+uint32_t COMPACT_SWEEP = 65536; // bricks the compact pass looks at each frame, the whole world every NUM_BRICKS/this frames.
+uint32_t BRICK_LISTS = 65536; // bricks that can empty, or slots be orphaned, between two recycles.
 
 // screen
 unsigned int SCR_WIDTH = 800;
@@ -53,6 +86,14 @@ unsigned int PRE_WIDTH = RES_WIDTH/PASS_RES;
 unsigned int PRE_HEIGHT = RES_HEIGHT/PASS_RES;
 
 float RENDER_DISTANCE = 768.0;
+bool REPROJECT_PREPASS = true; // low res rays start from last frame's depths, so only what the motion uncovers is traced in full.
+bool VOXEL_ATLAS = false; // high res pass fetches voxels from a 3D texture copy of the brick pool, +256 MiB.
+bool BRICK_CACHE = false; // high res work groups load the bricks around their prepass hits into shared memory first.
+float TIMING_INTERVAL = 0.0; // seconds between printing the average high res pass time, 0 for never.
+std::string CAMERA_PATH = "Worlds/camera.path"; // benchmark flight, F9 records it and F10 plays it back, see CameraPath.h.
+float CAMERA_PATH_STEP = 1.0f/60.0f; // seconds of the flight per played frame, the same frames whatever the frame rate.
+std::string BENCHMARK_LOG = "Worlds/benchmarks.csv"; // a line per finished flight, with the high res pass mode and times.
+float LOD_SCALE = 1.0; // far voxels are traced in coarser mips once a pixel covers 1, 2 and 4 of them, times this. 0 turns it off.
 
 unsigned int AO_DIAMETER = 5;
 unsigned int AO_SKIPPING = 2;
@@ -62,13 +103,52 @@ unsigned int AO_CELLS = (AO_DIAMETER+1)*(AO_DIAMETER+1)*((AO_DIAMETER+1)/2);
 unsigned int SIM_AXIS_SIZE = 384; // only does x and z, physics simulated always vertically
 unsigned int PHYSICS_TICKS = 2;
 
+// materials, indexed by voxel value. air is the sky color, brushes 0-9 place materials 1-10.
+// color, opacity, physics class, emissive (not shaded by the sun).
+std::vector<MaterialTable::Material> MATERIALS = {
+    {{0.4f, 0.6f, 1.0f}, 1.0f, MaterialTable::STATIC, true}, // air, sky.
+    {{0.1f, 0.7f, 0.1f}, 1.0f, MaterialTable::STATIC, false}, // grass.
+    {{0.1f, 0.8f, 0.0f}, 1.0f, MaterialTable::STATIC, false}, // tall grass.
+    {{1.0f, 0.3f, 0.5f}, 1.0f, MaterialTable::STATIC, false}, // pink flower.
+    {{1.0f, 0.5f, 0.1f}, 1.0f, MaterialTable::STATIC, false}, // orange flower.
+    {{0.6f, 0.3f, 0.0f}, 1.0f, MaterialTable::STATIC, false}, // dirt.
+    {{0.5f, 0.5f, 0.5f}, 1.0f, MaterialTable::STATIC, false}, // stone.
+    {{0.5f, 0.5f, 0.1f}, 1.0f, MaterialTable::POWDER, false}, // sand.
+    {{0.2f, 0.8f, 1.0f}, 0.5f, MaterialTable::LIQUID, false}, // water.
+    {{1.0f, 1.0f, 1.0f}, 1.0f, MaterialTable::STATIC, true}, // cloud.
+    {{0.4f, 0.6f, 1.0f}, 1.0f, MaterialTable::STATIC, true}, // sky.
+};
+
 // brushes
 int brushSize = 16;
+size_t UNDO_BUDGET = 64*1024*1024; // GPU memory for brick snapshots, the oldest edits are forgotten past it.
+
+// world paging
+unsigned int PAGE_COLUMNS = 1; // full height columns of 64x64 voxels paged per frame as the window follows the player.
+unsigned int PAGE_SLOTS = 4; // columns in flight between the GPU copies and the region file thread, about 16 MiB each way.
+
+// world streaming
+size_t STREAM_BUDGET = 64*1024*1024; // host memory used for staging world uploads.
+unsigned int STREAM_SLOTS = 4; // slices in flight, disk reads overlap with the GPU copying the previous slices.
+
+// host mirror of the world
+size_t MIRROR_BUDGET = 4*1024*1024; // host memory for reading back changed bricks, a slot of it per frame.
+unsigned int MIRROR_SLOTS = 4; // frames of changes in flight.
+
+// saving
+unsigned int JOURNAL_BATCH = 65536; // changed bricks per journal batch of an incremental save.
+uint64_t JOURNAL_LIMIT = 64*1024*1024; // journal size at which the next save rewrites the whole world file.
+float AUTOSAVE_INTERVAL = 300.0; // seconds between background saves.
+size_t AUTOSAVE_SLICE = 4*1024*1024; // voxel bytes copied out per frame during a background save.
+unsigned int AUTOSAVE_SLOTS = 4; // slices in flight between the GPU copy and the encoding thread.
 
 // buffer sizes
-const size_t SSBO0_SIZE = sizeof(GLuint) * (NUM_VUINTS);
-const size_t SSBO1_SIZE = sizeof(GLuint) * (NUM_GUINTS);
+const unsigned int MASK_LEVELS = 4; // occupancy at 4^3, 16^3, 64^3 and 256^3 voxels, 64 cells per cell above.
+const size_t SSBO1_SIZE = sizeof(GLuint) * ((NUM_BRICKS+31)/32 + (NUM_BRICKS/64+31)/32 + (NUM_BRICKS/4096+31)/32 + (NUM_BRICKS/262144+31)/32); // one bit per cell.
 const size_t SSBO2_SIZE = 2*sizeof(GLuint) + sizeof(GL_INT_VEC3)*6*AO_CELLS; // cells amount, plus rectangle of 
+const size_t SSBO3_SIZE = sizeof(GLuint) * (NUM_BRICKS/32);
+const size_t UNDO_RECORDS = UNDO_BUDGET/(sizeof(GLuint)*(BRICK_UINTS+1));
+const size_t SSBO5_SIZE = sizeof(GLuint) * (2 + UNDO_RECORDS*(BRICK_UINTS+1)); // count and rejected flag, then brick index and data per snapshot.
 
 int main() {
     // MAIN LOOP
@@ -78,6 +158,7 @@ int main() {
     
     // world creation or loading.
     std::string worldFilePath = "Worlds/"+userInput+".pun";
+    WorldFile worldFile(worldFilePath, WORLD_X, WORLD_Y, WORLD_Z, PASS_RES);
     if (Startup.newWorld) std::cout << "Creating world: "<<worldFilePath<< std::endl;
     else std::cout << "Loading world: "<<worldFilePath<<"\n"<<std::endl;
 
@@ -114,14 +195,29 @@ int main() {
     // hide mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    // build and compile shader program
+    // build and compile shader program, specialized on the world size.
+    Shader::defines = "#define WORLD_X "+std::to_string(WORLD_X)+"\n#define WORLD_Y "+std::to_string(WORLD_Y)+"\n#define WORLD_Z "+std::to_string(WORLD_Z)+"\n";
+    if (VOXEL_ATLAS) Shader::defines += "#define VOXEL_ATLAS\n";
+    if (BRICK_CACHE) Shader::defines += "#define BRICK_CACHE\n";
     Shader terrainShader("shaders/4.3.terrain.comp");
     Shader physicsShader("shaders/4.3.physics.comp");
     Shader terrainMaskShader("shaders/4.3.terrainmask.comp");
+    Shader maskPyramidShader("shaders/4.3.maskpyramid.comp");
+    Shader distPrepareShader("shaders/4.3.distprepare.comp");
+    Shader distFieldShader("shaders/4.3.distfield.comp");
     Shader precomputesShader("shaders/4.3.precomputes.comp");
+    Shader reprojectShader("shaders/4.3.reproject.comp");
     Shader lowResShader("shaders/4.3.lowrespass.comp");
     Shader highResShader("shaders/4.3.highrespass.comp");
     Shader blockEditShader("shaders/4.3.blockeditor.comp");
+    Shader undoShader("shaders/4.3.undo.comp");
+    Shader brickScatterShader("shaders/4.3.brickscatter.comp");
+    Shader brickDenseShader("shaders/4.3.brickdense.comp");
+    Shader brickRecycleShader("shaders/4.3.brickrecycle.comp");
+    Shader brickClearShader("shaders/4.3.brickclear.comp");
+    Shader brickCompactShader("shaders/4.3.brickcompact.comp");
+    Shader materialMipsShader("shaders/4.3.materialmips.comp");
+    Shader mirrorGatherShader("shaders/4.3.mirrorgather.comp");
     Shader screenShader("shaders/4.3.screenquad.vert","shaders/4.3.screen.frag");
     lowResPtr = &lowResShader; // pointer for screen resizing
     highResPtr = &highResShader; // pointer for screen resizing
@@ -132,12 +228,24 @@ int main() {
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
 
-    // construct voxel data buffer.
-    GLuint ssbo0;
-    glGenBuffers(1, &ssbo0);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo0);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, SSBO0_SIZE, nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ssbo0); // very important, don't forget, deleted accidentally once and could not figure out what was going wrong for like an hour.
+    // construct voxel data buffers, the brick pool (binding 0) and the brick map and allocator beside it (6 to 8) and the compact pool (18).
+    BrickPool bricks(NUM_BRICKS, POOL_BRICKS, COMPACT_BRICKS, BRICK_LISTS, BRICK_UINTS, STREAM_BUDGET/STREAM_SLOTS, brickScatterShader, brickDenseShader, brickRecycleShader, brickClearShader, brickCompactShader);
+
+    // brick distance field for skipping empty space, rebuilt in full on the first update.
+    DistanceField distances(NUM_BRICKS, WORLD_X/PASS_RES, WORLD_Y/PASS_RES, WORLD_Z/PASS_RES, distPrepareShader, distFieldShader);
+
+    // coarser material copies for tracing far away, rebuilt in full on the first update.
+    MaterialMips mips(NUM_BRICKS, POOL_BRICKS, materialMipsShader);
+
+    // texture copy of the brick pool, filled by the mip pass.
+    std::unique_ptr<BrickAtlas> atlas;
+    if (VOXEL_ATLAS) atlas.reset(new BrickAtlas(POOL_BRICKS));
+    GpuTimer highResTimer(std::string("High res pass (") + (VOXEL_ATLAS ? "atlas" : "ssbo") + (BRICK_CACHE ? ", brick cache)" : ")"), TIMING_INTERVAL);
+    CameraPath cameraPath(CAMERA_PATH, 0.25f, CAMERA_PATH_STEP);
+
+    // the world on the host, for CPU queries and saving without reading the brick pool back.
+    WorldVolume volume(WORLD_X, WORLD_Y, WORLD_Z);
+    WorldMirror mirror(volume, MIRROR_BUDGET, MIRROR_SLOTS, mirrorGatherShader);
 
     // occupancy mask data buffer.
     GLuint ssbo1;
@@ -152,7 +260,32 @@ int main() {
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo2);
     glBufferData(GL_SHADER_STORAGE_BUFFER, SSBO2_SIZE, nullptr, GL_DYNAMIC_DRAW);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, ssbo2); // very important, don't forget, deleted accidentally once and could not figure out what was going wrong for like an hour.
-    
+
+    // dirty brick mask, flags bricks edited until the mirror gather hands them to the host journal flags.
+    GLuint ssbo3;
+    glGenBuffers(1, &ssbo3);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo3);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, SSBO3_SIZE, nullptr, GL_DYNAMIC_DRAW);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, ssbo3);
+
+    // snapshot pool for undoing edits.
+    GLuint ssbo5;
+    glGenBuffers(1, &ssbo5);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo5);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, SSBO5_SIZE, nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, ssbo5);
+    EditHistory history(ssbo5, UNDO_RECORDS, PASS_RES);
+
+    // material properties, binding 13.
+    MaterialTable materials(MATERIALS);
+
+    // the window onto the endless world, columns left behind go to region files next to the world file.
+    WorldPager pager(worldFilePath, bricks, terrainShader, terrainMaskShader, WORLD_X, WORLD_Y, WORLD_Z, PASS_RES, PAGE_SLOTS);
+
+    // background saving, released before the context goes away.
+    std::unique_ptr<AutoSaver> saver(new AutoSaver(worldFile, volume, worldFile.rawSize(), AUTOSAVE_SLICE, AUTOSAVE_SLOTS));
+
     updateSettings();
 
     // precompute AO hemispheres.
@@ -165,34 +298,52 @@ int main() {
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
     // if new world needed, create one, otherwise load file.
+    bool fullSave = true; // new worlds have no world file to journal against.
+    bool loadFailed = false; // keeps a world file that could not be read from being overwritten.
+    std::unique_ptr<WorldStreamer> streamer;
     if (Startup.newWorld) {
         // generate terrain
         terrainShader.use();
 
         // dispatch compute shader threads, based on thread pool size of 64.
-        glDispatchCompute(AXIS_SIZE/4, AXIS_SIZE/4, AXIS_SIZE/4);
+        glDispatchCompute(WORLD_X/4, WORLD_Y/4, WORLD_Z/4);
 
         // make sure writes are visible to everything else
         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-    } else { // load.
-        std::vector<uint32_t> hostData(NUM_VUINTS);
-        std::ifstream inFile(worldFilePath, std::ios::binary);
-        inFile.read(reinterpret_cast<char*>(hostData.data()), SSBO0_SIZE);
-        inFile.close();
-        
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo0);
-        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, SSBO0_SIZE, hostData.data());
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        mirror.markAll(); // terrain does not flag what it writes.
+    } else if (worldFile.open()) { // load.
+        // stream world in around the player over the first frames, the rest of the world reads as air until it arrives.
+        if (worldFile.hasPlayer) {
+            Player.posX = worldFile.player[0];
+            Player.posY = worldFile.player[1];
+            Player.posZ = worldFile.player[2];
+        }
+        pager.start(worldFile.window[0], worldFile.window[1]);
+        streamer.reset(new WorldStreamer(worldFile, bricks, ssbo1, STREAM_BUDGET, STREAM_SLOTS));
+        streamer->start(pager.bufferCoord(Player.posX, 0), Player.posY, pager.bufferCoord(Player.posZ, 2));
+        std::cout<<"Loading v"<<worldFile.version<<" world file"<<std::endl;
+    } else {
+        std::cout<<"Failed to load world: "<<worldFilePath<<std::endl;
+        loadFailed = true;
+        bricks.reset();
     }
 
-    // generate terrain
-    terrainMaskShader.use();
+    // generate occupancy mask, streamed worlds bring their own.
+    if (!streamer) {
+        terrainMaskShader.use();
 
-    // dispatch compute shader threads, based on thread pool size of 64. Second 4 is because only one thread per chunk is dispatched.
-    glDispatchCompute((AXIS_SIZE)/(4*PASS_RES), (AXIS_SIZE)/(4*PASS_RES), (AXIS_SIZE)/(4*PASS_RES));
+        // dispatch compute shader threads, based on thread pool size of 64. Second 4 is because only one thread per chunk is dispatched.
+        glDispatchCompute((WORLD_X)/(4*PASS_RES), (WORLD_Y)/(4*PASS_RES), (WORLD_Z)/(4*PASS_RES));
 
-    // make sure writes are visible to everything else
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        // make sure writes are visible to everything else
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        buildMaskPyramid(maskPyramidShader);
+        distances.update();
+        bricks.recycle();
+        bricks.compact(NUM_BRICKS); // the whole world once, the sweep keeps up with edits from here.
+        mips.update();
+        if (!loadFailed) bricks.report();
+    }
 
     // random number setup
     std::random_device rd;
@@ -203,7 +354,12 @@ int main() {
     float deltaTime = 0.0f;
     float lastTime = 0.0f;
     int lastClick = 0;
+    int editSize = 0; // brush size of the last edit, the block editor keeps the rest of its uniforms for a retry.
+    bool editRetried = false;
     int AOframeMod = 0;
+    float lastSave = 0.0f;
+    float lastPos[3] = {0.0f, 0.0f, 0.0f}; // player position and direction of the last prepass.
+    float lastDir[3] = {0.0f, 0.0f, 1.0f};
 
     while (!glfwWindowShouldClose(window))
     {
@@ -212,63 +368,196 @@ int main() {
         deltaTime = currentTime - lastTime;
         lastTime = currentTime;
 
+        // world streaming, edits and saves wait until the whole world is in.
+        if (streamer && streamer->update()) {
+            if (streamer->failed) loadFailed = true;
+            else {
+                std::cout<<"Loaded world in "<<currentTime<<"s"<<std::endl;
+                bricks.report();
+            }
+            fullSave = loadFailed;
+            streamer.reset();
+            worldFile.close();
+        }
+        bool loading = bool(streamer);
+
+        // page the window along with the player, not while a save is copying the buffer out.
+        bool paged = true;
+        if (!loading && !loadFailed && !saver->active) {
+            paged = pager.update(PAGE_COLUMNS, Player.posX, Player.posZ);
+            if (pager.moved) {
+                // the journal and undo snapshots refer to buffer bricks, which now hold other columns.
+                fullSave = true;
+                history.clear();
+                pager.moved = false;
+            }
+        }
+
+        // background save, once the window is whole.
+        if (!loading && !loadFailed && paged && !saver->active && currentTime - lastSave > AUTOSAVE_INTERVAL) {
+            std::cout<<"Autosaving world"<<std::endl;
+            worldFile.player[0] = Player.posX;
+            worldFile.player[1] = Player.posY;
+            worldFile.player[2] = Player.posZ;
+            worldFile.window[0] = pager.windowX();
+            worldFile.window[1] = pager.windowZ();
+            mirror.sync(); // a frame or two of changes, the save is copied out of the host copy.
+            saver->start();
+            lastSave = currentTime;
+        }
+        if (saver->active && saver->update()) {
+            // with the changed flags cleared at the start, a failed save leaves only a full save safe.
+            fullSave = !saver->succeeded;
+            if (saver->succeeded) {
+                std::cout<<"Autosaved world"<<std::endl;
+                bricks.report();
+            }
+            else std::cout<<"Autosave failed"<<std::endl;
+        }
+
         Player.HandleInputs(window, deltaTime);
         Player.HandleMouseInput(window);
         processInput(window);
+        cameraPath.update(window, Player, currentTime, deltaTime);
+        if (cameraPath.started) highResTimer.startRun();
+        if (cameraPath.finished) {
+            highResTimer.reportRun();
+            std::string mode = std::string(VOXEL_ATLAS ? "atlas" : "ssbo") + (BRICK_CACHE ? " brick cache" : "") + " " + std::to_string(RES_WIDTH) + "x" + std::to_string(RES_HEIGHT);
+            cameraPath.logResult(BENCHMARK_LOG, mode, highResTimer.runAverage());
+        }
+
+        // shaders see the player in the buffer, the world wraps around it every WORLD_X and WORLD_Z voxels.
+        float bufPosX = pager.bufferCoord(Player.posX, 0);
+        float bufPosZ = pager.bufferCoord(Player.posZ, 2);
+        // the columns that are in, rays end where they leave them rather than wrapping onto others.
+        std::pair<float, float> windowX = pager.bufferRange(Player.posX, 0);
+        std::pair<float, float> windowZ = pager.bufferRange(Player.posZ, 2);
 
         // block editing. 
-        if (Player.click != 0 && lastClick != Player.click) {
+        if (Player.click != 0 && lastClick != Player.click && !loading) {
             blockEditShader.use();
             glfwSetScrollCallback(window, scroll_callback);
 
             blockEditShader.setBool("click", (Player.click==1));
             blockEditShader.setInt("brush", Player.brush);
             blockEditShader.setInt("brushSize", brushSize);
-            blockEditShader.setFloat("pPosX", Player.posX);
+            blockEditShader.setFloat("pPosX", bufPosX);
             blockEditShader.setFloat("pPosY", Player.posY);
-            blockEditShader.setFloat("pPosZ", Player.posZ);
+            blockEditShader.setFloat("pPosZ", bufPosZ);
             blockEditShader.setFloat("pDirX", Player.dirX);
             blockEditShader.setFloat("pDirY", Player.dirY);
             blockEditShader.setFloat("pDirZ", Player.dirZ);
-            
-            glDispatchCompute(1, 1, 1);
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            setWindow(blockEditShader, windowX, windowZ);
+            editSize = brushSize;
+            editRetried = false;
+            dispatchEdit(blockEditShader, history, editSize);
         }
         lastClick = Player.click;
 
+        // undo/redo.
+        history.update();
+        // the brick pool could not take the last edit, which changed nothing. free what the pool can spare and try once more.
+        if (history.rejected && !loading) {
+            history.rejected = false;
+            if (!editRetried) {
+                editRetried = true;
+                bricks.recycle();
+                bricks.compact(NUM_BRICKS);
+                dispatchEdit(blockEditShader, history, editSize);
+            } else {
+                std::cout<<"Brick pool full, edit rejected. Raise POOL_BRICKS"<<std::endl;
+            }
+        }
+        if (Player.history != 0 && !loading) {
+            bool changed = Player.history < 0 ? history.undo(undoShader) : history.redo(undoShader);
+            if (!changed) std::cout<<"Nothing to "<<(Player.history < 0 ? "undo" : "redo")<<std::endl;
+        }
+
         // physics pass.
-        if (Player.physicsToggle) {
+        if (Player.physicsToggle && !loading) {
         for (int i = 0; i < PHYSICS_TICKS; i++) {
         physicsShader.use();
         auto random_number = dis(gen);
         physicsShader.setInt("random", random_number);
         //physicsShader.setFloat("iTime", currentTime);
-        physicsShader.setInt("cPPosX", ((int(Player.posX)-SIM_AXIS_SIZE/2))/PASS_RES);
-        physicsShader.setInt("cPPosZ", ((int(Player.posZ)-SIM_AXIS_SIZE/2))/PASS_RES);
+        physicsShader.setInt("cPPosX", int(std::floor((bufPosX-SIM_AXIS_SIZE/2)/PASS_RES)));
+        physicsShader.setInt("cPPosZ", int(std::floor((bufPosZ-SIM_AXIS_SIZE/2)/PASS_RES)));
         // first *4 is to fit in thread pool, second is to fit in chunk. Physics is done per chunk.
-        glDispatchCompute(SIM_AXIS_SIZE/(4*PASS_RES), AXIS_SIZE/(4*PASS_RES), SIM_AXIS_SIZE/(4*PASS_RES));
+        glDispatchCompute(SIM_AXIS_SIZE/(4*PASS_RES), WORLD_Y/(4*PASS_RES), SIM_AXIS_SIZE/(4*PASS_RES));
         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
         }}
 
         // generate terrain
         terrainMaskShader.use();
-        terrainMaskShader.setInt("cPPosX", ((int(Player.posX)-SIM_AXIS_SIZE/2))/PASS_RES);
-        terrainMaskShader.setInt("cPPosZ", ((int(Player.posZ)-SIM_AXIS_SIZE/2))/PASS_RES);
+        terrainMaskShader.setInt("cPPosX", int(std::floor((bufPosX-SIM_AXIS_SIZE/2)/PASS_RES)));
+        terrainMaskShader.setInt("cPPosZ", int(std::floor((bufPosZ-SIM_AXIS_SIZE/2)/PASS_RES)));
 
         // dispatch compute shader threads, based on thread pool size of 64. Second 4 is because only one thread per chunk is dispatched.
-        glDispatchCompute((SIM_AXIS_SIZE)/(4*PASS_RES), (AXIS_SIZE)/(4*PASS_RES), (SIM_AXIS_SIZE)/(4*PASS_RES));
+        glDispatchCompute((SIM_AXIS_SIZE)/(4*PASS_RES), (WORLD_Y)/(4*PASS_RES), (SIM_AXIS_SIZE)/(4*PASS_RES));
+
+        // coarse occupancy for the low res pass, also picks up edits and streamed regions.
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        buildMaskPyramid(maskPyramidShader);
+        distances.update(); // around bricks flipped this frame.
+
+        // free the slots of bricks that emptied this frame, and move a window of bricks into the compact pool.
+        bricks.recycle();
+        bricks.compact(COMPACT_SWEEP);
+
+        // mips of the bricks written this frame, and their changes on the way to the host.
+        mips.update();
+        mirror.update();
+
+        // last frame's prepass moved into this view, the low res pass starts its rays from it. positions are taken in
+        // world space, so the buffer wrapping under the player is not motion.
+        bool reproject = REPROJECT_PREPASS && !prePassStale;
+        float moved[3] = {Player.posX - lastPos[0], Player.posY - lastPos[1], Player.posZ - lastPos[2]};
+        if (reproject) {
+            reprojectShader.use();
+            reprojectShader.setInt("passWidth", PRE_WIDTH);
+            reprojectShader.setInt("passHeight", PRE_HEIGHT);
+            reprojectShader.setFloat("renderDist", RENDER_DISTANCE);
+            reprojectShader.setBool("clear", true); // glClearTexImage is 4.4.
+            glDispatchCompute((PRE_WIDTH+7)/8, (PRE_HEIGHT+7)/8, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            reprojectShader.setBool("clear", false);
+            reprojectShader.setFloat("pPosX", bufPosX);
+            reprojectShader.setFloat("pPosY", Player.posY);
+            reprojectShader.setFloat("pPosZ", bufPosZ);
+            reprojectShader.setFloat("pDirX", Player.dirX);
+            reprojectShader.setFloat("pDirY", Player.dirY);
+            reprojectShader.setFloat("pDirZ", Player.dirZ);
+            reprojectShader.setFloat("lastPosX", bufPosX - moved[0]);
+            reprojectShader.setFloat("lastPosY", Player.posY - moved[1]);
+            reprojectShader.setFloat("lastPosZ", bufPosZ - moved[2]);
+            reprojectShader.setFloat("lastDirX", lastDir[0]);
+            reprojectShader.setFloat("lastDirY", lastDir[1]);
+            reprojectShader.setFloat("lastDirZ", lastDir[2]);
+            glDispatchCompute((PRE_WIDTH+7)/8, (PRE_HEIGHT+7)/8, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
 
         // low res pass.
         lowResShader.use();
-        lowResShader.setFloat("pPosX", Player.posX);
+        lowResShader.setBool("reproject", reproject);
+        lowResShader.setFloat("motion", std::sqrt(moved[0]*moved[0] + moved[1]*moved[1] + moved[2]*moved[2]));
+        lowResShader.setFloat("pPosX", bufPosX);
         lowResShader.setFloat("pPosY", Player.posY);
-        lowResShader.setFloat("pPosZ", Player.posZ);
+        lowResShader.setFloat("pPosZ", bufPosZ);
         lowResShader.setFloat("pDirX", Player.dirX);
         lowResShader.setFloat("pDirY", Player.dirY);
         lowResShader.setFloat("pDirZ", Player.dirZ);
+        setWindow(lowResShader, windowX, windowZ);
 
         // dispatch low res compute shader threads, based on thread pool size of 64.
         glDispatchCompute((PRE_WIDTH+7)/8, (PRE_HEIGHT+7)/8, 1);
+        lastPos[0] = Player.posX;
+        lastPos[1] = Player.posY;
+        lastPos[2] = Player.posZ;
+        lastDir[0] = Player.dirX;
+        lastDir[1] = Player.dirY;
+        lastDir[2] = Player.dirZ;
+        prePassStale = false;
 
         // make sure writes are visible to everything else
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
@@ -284,16 +573,19 @@ int main() {
         // high res pass.
         highResShader.use();
         highResShader.setInt("AOframeMod", AOframeMod);
-        highResShader.setFloat("pPosX", Player.posX);
+        highResShader.setFloat("pPosX", bufPosX);
         highResShader.setFloat("pPosY", Player.posY);
-        highResShader.setFloat("pPosZ", Player.posZ);
+        highResShader.setFloat("pPosZ", bufPosZ);
         highResShader.setFloat("pDirX", Player.dirX);
         highResShader.setFloat("pDirY", Player.dirY);
         highResShader.setFloat("pDirZ", Player.dirZ);
         highResShader.setFloat("iTime", currentTime);
+        setWindow(highResShader, windowX, windowZ);
 
         // dispatch high res compute shader threads, based on thread pool size of 64.
+        highResTimer.begin();
         glDispatchCompute((RES_WIDTH+7)/8, (RES_HEIGHT+7)/8, 1);
+        highResTimer.end(currentTime);
 
         // make sure writes are visible to everything else
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
@@ -311,19 +603,45 @@ int main() {
 
     // save world to worlds file.
     glfwHideWindow(window); // hides window so terminal is visible.
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo0);
-    void* ptr = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, SSBO0_SIZE, GL_MAP_READ_BIT);
-    if (ptr) {
-        std::cout<<"\n"<<"Saving world to: "<<worldFilePath<<std::endl;
-        std::ofstream outFile(worldFilePath, std::ios::binary);
-        outFile.write(reinterpret_cast<char*>(ptr), SSBO0_SIZE);
-        outFile.close();
-        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER); // Unmap after use
-        std::cout<<"\n"<<"World saved to: "<<worldFilePath<<std::endl;
-    } else {
-        std::cout<<"\n"<<"failed to write"<<std::endl;
+    // a world still streaming in has to be complete before it is saved.
+    if (streamer) {
+        while (!streamer->update()) {}
+        if (streamer->failed) loadFailed = true;
+        fullSave = loadFailed;
+        streamer.reset();
+        worldFile.close();
     }
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    std::cout<<"\n"<<"Saving world to: "<<worldFilePath<<std::endl;
+    worldFile.player[0] = Player.posX;
+    worldFile.player[1] = Player.posY;
+    worldFile.player[2] = Player.posZ;
+
+    // let a running autosave land first, it decides whether a journal can go on top.
+    if (saver->active) {
+        while (!saver->update(AUTOSAVE_SLOTS)) std::this_thread::yield();
+        fullSave = !saver->succeeded;
+    }
+
+    // the window is saved whole, columns still to be paged are paged now.
+    if (!loadFailed) {
+        pager.drain(Player.posX, Player.posZ);
+        if (pager.moved) fullSave = true;
+    }
+    worldFile.window[0] = pager.windowX();
+    worldFile.window[1] = pager.windowZ();
+
+    // only changed bricks are journaled, until the journal grows big enough to be folded into the world file.
+    if (worldFile.journalSize() > JOURNAL_LIMIT) fullSave = true;
+    bool saved = false;
+    if (loadFailed) std::cout<<"Not saving, the world file could not be read"<<std::endl;
+    else if (!fullSave) saved = saveIncremental(worldFile, mirror, volume);
+    else {
+        mirror.sync(); // the host copy is the world, once the last changes are in.
+        saved = volume.save(worldFile, AUTOSAVE_SLICE);
+    }
+    saver.reset();
+    if (saved) std::cout<<"\n"<<"World saved to: "<<worldFilePath<<std::endl;
+    else std::cout<<"\n"<<"failed to write"<<std::endl;
     std::cout<<"\n"<<std::endl;
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -361,6 +679,7 @@ void updateSettings() {
     highRes.setInt("passWidth", RES_WIDTH);
     highRes.setInt("passHeight", RES_HEIGHT);
     highRes.setFloat("renderDist", RENDER_DISTANCE);
+    highRes.setFloat("lodScale", LOD_SCALE);
 
     Shader screen = *screenPtr; // screen shader resize.
     screen.use(); // uses screen shader.
@@ -374,7 +693,14 @@ void updateSettings() {
     glGenTextures(1, &prePassTex);
     glBindTexture(GL_TEXTURE_2D, prePassTex);
     glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, PRE_WIDTH, PRE_HEIGHT);
-    glBindImageTexture(0, prePassTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glBindImageTexture(0, prePassTex, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F); // read by the next frame's reprojection.
+
+    // reprojection texture (last prepass depths in this view, float bits for atomicMin).
+    glGenTextures(1, &reprojTex);
+    glBindTexture(GL_TEXTURE_2D, reprojTex);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, PRE_WIDTH, PRE_HEIGHT);
+    glBindImageTexture(3, reprojTex, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    prePassStale = true;
 
     // screen texture (screen color data).
     glGenTextures(1, &screenTex);
@@ -390,6 +716,31 @@ void updateSettings() {
     glUniform1i(glGetUniformLocation(screen.ID, "screen"), 0); // set sampler uniform.
 }
 
+// appends only the bricks edited since the last save to the world journal, from the host copy once it caught up.
+bool saveIncremental(WorldFile& worldFile, WorldMirror& mirror, WorldVolume& volume) {
+    mirror.sync();
+    int64_t total = volume.journal(worldFile, JOURNAL_BATCH);
+    if (total < 0) return false;
+
+    std::cout<<"Journaled "<<total<<" changed bricks ("<<worldFile.journalSize()/1024<<" KiB journal)"<<std::endl;
+
+    // the header keeps where the player left off, the next load starts there.
+    if (!worldFile.writePosition()) std::cout<<"Could not store the player position in "<<worldFile.path<<std::endl;
+    return true;
+}
+
+// rebuilds the coarse occupancy levels from the brick level up. a cell is empty when all 64 cells below it are,
+// which being morton ordered are two words, so rebuilding every level reads the brick mask once (2 MiB).
+void buildMaskPyramid(Shader& pyramidShader) {
+    pyramidShader.use();
+    for (unsigned int level = 1; level < MASK_LEVELS; level++) {
+        unsigned int words = ((NUM_BRICKS >> (6*level))+31)/32;
+        pyramidShader.setInt("level", level);
+        glDispatchCompute((words+63)/64, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     if (yoffset > 0) {
         if (brushSize < 64) brushSize *=2;
@@ -413,4 +764,21 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 
     // make sure the viewport matches the new window dimensions; note that width and height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height); // resize viewport
-}
\ No newline at end of file
+}
+
+// the loaded window, buffer voxels along x and z, for the shaders that clip rays to it.
+void setWindow(Shader& shader, std::pair<float, float> x, std::pair<float, float> z) {
+    shader.setFloat("windowLoX", x.first);
+    shader.setFloat("windowHiX", x.second);
+    shader.setFloat("windowLoZ", z.first);
+    shader.setFloat("windowHiZ", z.second);
+}
+
+// runs the block editor with the uniforms it was given, snapshotting for undo.
+void dispatchEdit(Shader& editShader, EditHistory& history, int size) {
+    editShader.use();
+    history.begin(editShader, size);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    history.commit();
+}
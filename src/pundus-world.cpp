@@ -0,0 +1,318 @@
+// pundus-world: headless world file tool. works on .pun files on the CPU, without a window or GL context,
+// streaming them a chunk of segments at a time so memory stays constant whatever the world size.
+// voxels are the same bytes as in ssbo0, one per voxel in world layout order (WorldLayout in Morton.h),
+// packed four to a uint from the low byte up, as getData()/setData() read and write them.
+
+#include <classes/Morton.h>
+#include <classes/WorldFile.h>
+#include <classes/WorldPatch.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// SETTINGS
+unsigned int SIZE[3] = {1024, 1024, 1024}; // world voxels along x, y and z, as WORLD_X, WORLD_Y and WORLD_Z in main.cpp.
+unsigned int PASS_RES = 4;
+unsigned int CHUNK_SEGMENTS = 64; // segments decoded at once, 16 MiB of voxels with the default world.
+
+void usage() {
+    std::cout<<"usage: pundus-world [--size X Y Z | --axis N] [--res N] <command> ..."<<std::endl;
+    std::cout<<"  stats <world>                              fill ratio, material counts and empty bricks."<<std::endl;
+    std::cout<<"  verify <world>                             decodes everything and checks the stored mask."<<std::endl;
+    std::cout<<"  convert <in> <out> [version]               rewrites in the current format, or as a raw v1 dump."<<std::endl;
+    std::cout<<"  crop <in> <out> x0 y0 z0 x1 y1 z1          clears everything outside [x0,x1) [y0,y1) [z0,z1)."<<std::endl;
+    std::cout<<"  translate <in> <out> dx dy dz              moves the world, whatever moves past the edges is lost."<<std::endl;
+    std::cout<<"  remask <world>                             rebuilds the occupancy mask (and folds in the journal)."<<std::endl;
+    std::cout<<"  diff <base> <edited> <patch>               writes the bricks that differ from base to a patch."<<std::endl;
+    std::cout<<"  patch <base> <patch> <out>                 applies a patch made against base."<<std::endl;
+}
+
+uint64_t chunkSize(const WorldFile& world) {
+    return uint64_t(CHUNK_SEGMENTS)*world.segmentBricks*world.brickBytes;
+}
+
+// calls fn on every chunk of an opened world file, in order.
+bool forEachChunk(WorldFile& world, const std::function<void(uint64_t, uint64_t, const uint8_t*)>& fn) {
+    std::vector<uint8_t> chunk(std::min(chunkSize(world), world.rawSize()));
+    for (uint64_t offset = 0; offset < world.rawSize(); offset += chunk.size()) {
+        uint64_t size = std::min<uint64_t>(chunk.size(), world.rawSize()-offset);
+        if (!world.readRange(offset, size, chunk.data())) {
+            std::cout<<"Failed to decode voxels "<<offset<<" to "<<offset+size<<std::endl;
+            return false;
+        }
+        fn(offset, size, chunk.data());
+    }
+    return true;
+}
+
+// writes out a new world chunk by chunk, fill gets the chunks voxel range and fills it in.
+bool rewrite(WorldFile& in, WorldFile& out, const std::function<bool(uint64_t, uint64_t, uint8_t*)>& fill) {
+    std::vector<uint8_t> chunk(std::min(chunkSize(out), out.rawSize()));
+    if (!out.beginWrite()) {
+        std::cout<<"Failed to create "<<out.path<<std::endl;
+        return false;
+    }
+    for (uint64_t offset = 0; offset < out.rawSize(); offset += chunk.size()) {
+        uint64_t size = std::min<uint64_t>(chunk.size(), out.rawSize()-offset);
+        if (!fill(offset, size, chunk.data())) {
+            std::cout<<"Failed to decode voxels "<<offset<<" to "<<offset+size<<std::endl;
+            out.abortWrite();
+            return false;
+        }
+        if (!out.writeRange(offset, size, chunk.data())) {
+            std::cout<<"Failed to write "<<out.path<<std::endl;
+            out.abortWrite();
+            return false;
+        }
+    }
+    in.close(); // out may replace it.
+    return out.endWrite();
+}
+
+int stats(WorldFile& world) {
+    std::array<uint64_t, 256> counts = {};
+    uint64_t emptyBricks = 0;
+    uint64_t hash = WorldPatch::HASH_SEED;
+    bool decoded = forEachChunk(world, [&](uint64_t, uint64_t size, const uint8_t* voxels) {
+        hash = WorldPatch::hash(hash, voxels, size);
+        for (uint64_t i = 0; i < size; i++) counts[voxels[i]]++;
+        for (uint64_t b = 0; b < size; b += world.brickBytes) {
+            if (world.brickEmpty(voxels+b)) emptyBricks++;
+        }
+    });
+    if (!decoded) return 1;
+
+    uint64_t total = world.rawSize();
+    std::cout<<"World: "<<world.path<<" (v"<<world.version<<", "<<std::filesystem::file_size(world.path)/1024<<" KiB)"<<std::endl;
+    std::cout<<"Size: "<<world.size[0]<<"x"<<world.size[1]<<"x"<<world.size[2]<<", bricks: "<<world.numBricks<<" of "<<world.brickBytes<<" voxels"<<std::endl;
+    std::cout<<"Content hash: "<<std::hex<<hash<<std::dec<<std::endl;
+    if (world.hasPlayer) std::cout<<"Player: "<<world.player[0]<<" "<<world.player[1]<<" "<<world.player[2]<<std::endl;
+    if (world.window[0] != 0 || world.window[1] != 0) std::cout<<"Window origin: "<<world.window[0]<<" "<<world.window[1]<<std::endl;
+    std::cout<<"Fill ratio: "<<100.0*double(total-counts[0])/double(total)<<"%"<<std::endl;
+    std::cout<<"Empty bricks: "<<100.0*double(emptyBricks)/double(world.numBricks)<<"% ("<<emptyBricks<<")"<<std::endl;
+    for (unsigned int m = 1; m < 256; m++) {
+        if (counts[m] != 0) std::cout<<"  material "<<m<<": "<<counts[m]<<std::endl;
+    }
+    return 0;
+}
+
+int verify(WorldFile& world) {
+    std::vector<uint32_t> mask(world.maskWords());
+    bool hasMask = world.version >= 3 && world.readMask(mask.data());
+    if (world.version >= 3 && !hasMask) std::cout<<"Stored occupancy mask is missing or damaged"<<std::endl;
+
+    uint64_t errors = 0;
+    uint64_t maskErrors = 0;
+    std::vector<uint8_t> segment(uint64_t(world.segmentBricks)*world.brickBytes);
+    std::vector<uint8_t> chunk(std::min(chunkSize(world), world.rawSize()));
+    for (uint64_t offset = 0; offset < world.rawSize(); offset += chunk.size()) {
+        uint64_t size = std::min<uint64_t>(chunk.size(), world.rawSize()-offset);
+        if (!world.readRange(offset, size, chunk.data())) {
+            // narrow it down to the broken segments.
+            for (uint64_t s = offset; s < offset+size; s += segment.size()) {
+                if (world.readRange(s, std::min<uint64_t>(segment.size(), offset+size-s), segment.data())) continue;
+                std::cout<<"Damaged segment at voxel "<<s<<std::endl;
+                errors++;
+            }
+            continue;
+        }
+        if (!hasMask) continue;
+        for (uint64_t b = 0; b < size/world.brickBytes; b++) {
+            uint64_t brick = offset/world.brickBytes + b;
+            bool empty = (mask[brick >> 5] >> (brick & 31u)) & 1u;
+            if (empty != world.brickEmpty(chunk.data() + b*world.brickBytes)) maskErrors++;
+        }
+    }
+    if (maskErrors != 0) std::cout<<maskErrors<<" bricks disagree with the stored occupancy mask, run remask"<<std::endl;
+
+    if (errors != 0 || maskErrors != 0 || (world.version >= 3 && !hasMask)) {
+        std::cout<<"Verification failed: "<<world.path<<std::endl;
+        return 1;
+    }
+    std::cout<<"Verified: "<<world.path<<" (v"<<world.version<<")"<<std::endl;
+    return 0;
+}
+
+int convert(WorldFile& in, WorldFile& out, unsigned int version) {
+    if (version == WorldFile::VERSION) {
+        return rewrite(in, out, [&](uint64_t offset, uint64_t size, uint8_t* voxels) { return in.readRange(offset, size, voxels); }) ? 0 : 1;
+    }
+    if (version != 1) {
+        std::cout<<"Can only convert to v1 or v"<<WorldFile::VERSION<<std::endl;
+        return 1;
+    }
+
+    // raw dump, the journal is folded in like any other conversion.
+    std::string tmpPath = out.path + ".tmp";
+    std::ofstream outFile(tmpPath, std::ios::binary | std::ios::trunc);
+    bool decoded = forEachChunk(in, [&](uint64_t, uint64_t size, const uint8_t* voxels) {
+        outFile.write(reinterpret_cast<const char*>(voxels), size);
+    });
+    outFile.close();
+    in.close();
+    std::error_code ec;
+    if (!decoded || !outFile) {
+        std::filesystem::remove(tmpPath, ec);
+        return 1;
+    }
+    std::filesystem::rename(tmpPath, out.path, ec);
+    if (ec) { // some platforms refuse to rename over an existing file.
+        std::filesystem::remove(out.path, ec);
+        std::filesystem::rename(tmpPath, out.path, ec);
+    }
+    if (ec) {
+        // the journal stays, its bricks are only in the temporary file otherwise.
+        std::cout<<"Failed to write "<<out.path<<", converted world left in "<<tmpPath<<std::endl;
+        return 1;
+    }
+    std::filesystem::remove(out.journalPath(), ec);
+    if (ec) std::cout<<"Could not remove journal "<<out.journalPath()<<", it no longer applies"<<std::endl;
+    std::cout<<"Saved raw world ("<<out.rawSize()/(1024*1024)<<" MiB)"<<std::endl;
+    return 0;
+}
+
+int crop(WorldFile& in, WorldFile& out, const uint32_t lo[3], const uint32_t hi[3]) {
+    WorldLayout layout = in.layout();
+    return rewrite(in, out, [&](uint64_t offset, uint64_t size, uint8_t* voxels) {
+        if (!in.readRange(offset, size, voxels)) return false;
+        for (uint64_t b = 0; b < size; b += in.brickBytes) {
+            // whole bricks first, most are fully inside or outside.
+            uint32_t x, y, z;
+            layout.decode(uint32_t(offset+b), x, y, z);
+            uint32_t p = PASS_RES;
+            bool inside = x >= lo[0] && x+p <= hi[0] && y >= lo[1] && y+p <= hi[1] && z >= lo[2] && z+p <= hi[2];
+            bool outside = x+p <= lo[0] || x >= hi[0] || y+p <= lo[1] || y >= hi[1] || z+p <= lo[2] || z >= hi[2];
+            if (inside) continue;
+            if (outside) {
+                std::memset(voxels+b, 0, in.brickBytes);
+                continue;
+            }
+            for (uint64_t i = b; i < b+in.brickBytes; i++) {
+                layout.decode(uint32_t(offset+i), x, y, z);
+                if (x < lo[0] || x >= hi[0] || y < lo[1] || y >= hi[1] || z < lo[2] || z >= hi[2]) voxels[i] = 0;
+            }
+        }
+        return true;
+    }) ? 0 : 1;
+}
+
+int translate(WorldFile& in, WorldFile& out, const int32_t d[3]) {
+    // source voxels of a chunk come from the few segments it overlaps once moved, kept decoded here.
+    uint64_t segmentSize = uint64_t(in.segmentBricks)*in.brickBytes;
+    std::map<uint64_t, std::vector<uint8_t>> cache;
+    auto source = [&](uint64_t s) -> const uint8_t* {
+        auto it = cache.find(s);
+        if (it != cache.end()) return it->second.data();
+        if (cache.size() >= 4*CHUNK_SEGMENTS) cache.clear();
+        std::vector<uint8_t>& voxels = cache[s];
+        voxels.resize(segmentSize);
+        if (!in.readRange(s*segmentSize, segmentSize, voxels.data())) {
+            cache.erase(s);
+            return nullptr;
+        }
+        return voxels.data();
+    };
+
+    for (int a = 0; a < 3; a++) out.player[a] = in.player[a] + float(d[a]);
+    WorldLayout layout = in.layout();
+    return rewrite(in, out, [&](uint64_t offset, uint64_t size, uint8_t* voxels) {
+        const uint8_t* segment = nullptr;
+        uint64_t segmentIndex = UINT64_MAX;
+        for (uint64_t i = 0; i < size; i++) {
+            uint32_t x, y, z;
+            layout.decode(uint32_t(offset+i), x, y, z);
+            int64_t sx = int64_t(x)-d[0], sy = int64_t(y)-d[1], sz = int64_t(z)-d[2];
+            if (sx < 0 || sy < 0 || sz < 0 || sx >= in.size[0] || sy >= in.size[1] || sz >= in.size[2]) {
+                voxels[i] = 0;
+                continue;
+            }
+            uint64_t m = layout.index(uint32_t(sx), uint32_t(sy), uint32_t(sz));
+            if (m/segmentSize != segmentIndex) {
+                segmentIndex = m/segmentSize;
+                segment = source(segmentIndex);
+                if (!segment) return false;
+            }
+            voxels[i] = segment[m%segmentSize];
+        }
+        return true;
+    }) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i+3 < argc) {
+            for (int a = 0; a < 3; a++) SIZE[a] = unsigned(std::stoul(argv[++i]));
+        } else if (arg == "--axis" && i+1 < argc) {
+            SIZE[0] = SIZE[1] = SIZE[2] = unsigned(std::stoul(argv[++i]));
+        } else if (arg == "--res" && i+1 < argc) {
+            PASS_RES = unsigned(std::stoul(argv[++i]));
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.size() < 2) {
+        usage();
+        return 1;
+    }
+
+    const std::string& command = args[0];
+    WorldFile in(args[1], SIZE[0], SIZE[1], SIZE[2], PASS_RES);
+    if (!in.open()) {
+        std::cout<<"Failed to open world: "<<args[1]<<std::endl;
+        return 1;
+    }
+    if (command == "stats" && args.size() == 2) return stats(in);
+    if (command == "verify" && args.size() == 2) return verify(in);
+
+    // everything else writes a world, in place for remask.
+    std::string outPath = command == "remask" ? args[1] : (args.size() > 2 ? args[2] : "");
+    WorldFile out(outPath, SIZE[0], SIZE[1], SIZE[2], PASS_RES);
+    if (in.hasPlayer) std::memcpy(out.player, in.player, sizeof(out.player));
+    std::memcpy(out.window, in.window, sizeof(out.window));
+
+    try {
+        if (command == "remask" && args.size() == 2) {
+            return convert(in, out, WorldFile::VERSION);
+        } else if (command == "convert" && (args.size() == 3 || args.size() == 4)) {
+            return convert(in, out, args.size() == 4 ? unsigned(std::stoul(args[3])) : WorldFile::VERSION);
+        } else if (command == "crop" && args.size() == 9) {
+            uint32_t lo[3], hi[3];
+            for (int a = 0; a < 3; a++) {
+                lo[a] = uint32_t(std::stoul(args[3+a]));
+                hi[a] = uint32_t(std::stoul(args[6+a]));
+            }
+            return crop(in, out, lo, hi);
+        } else if (command == "diff" && args.size() == 4) {
+            WorldFile edited(args[2], SIZE[0], SIZE[1], SIZE[2], PASS_RES);
+            if (!edited.open()) {
+                std::cout<<"Failed to open world: "<<args[2]<<std::endl;
+                return 1;
+            }
+            return WorldPatch::create(in, edited, args[3], chunkSize(in)) ? 0 : 1;
+        } else if (command == "patch" && args.size() == 4) {
+            WorldFile patched(args[3], SIZE[0], SIZE[1], SIZE[2], PASS_RES);
+            if (in.hasPlayer) std::memcpy(patched.player, in.player, sizeof(patched.player));
+            std::memcpy(patched.window, in.window, sizeof(patched.window));
+            return WorldPatch::apply(in, args[2], patched, chunkSize(in)) ? 0 : 1;
+        } else if (command == "translate" && args.size() == 6) {
+            int32_t d[3];
+            for (int a = 0; a < 3; a++) d[a] = int32_t(std::stol(args[3+a]));
+            return translate(in, out, d);
+        }
+    } catch (...) {
+        std::cout<<"Invalid value."<<std::endl;
+        return 1;
+    }
+    usage();
+    return 1;
+}